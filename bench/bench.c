@@ -0,0 +1,905 @@
+// Microbenchmarks and workload benchmarks for the hot paths of ext_vector, ext_string, ext_map,
+// ext_intmap and ext_btree.
+// Results are printed on stdout as JSON, one object per benchmark.
+//
+// Usage: extlib_bench [--reps N] [--scale F] [filter...]
+//     --reps N   Run every benchmark N times and report the fastest run (default 5)
+//     --scale F  Multiply the size of all workloads by F (default 1.0)
+//     filter     Only run benchmarks whose name contains one of the filters
+//
+// Every benchmark runs in a child process of its own, so that `peak_rss_kb` is the peak resident
+// memory of that benchmark alone (plus the few MBs inherited from the harness). On Windows there is
+// no fork, and the peak is the one of the whole process so far.
+//
+// All inputs are generated from fixed seeds, so runs are reproducible across machines and
+// releases. Reference implementations from the C standard library (strstr, memchr, qsort) are
+// included where one exists, to put the numbers in context.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlib/btree.h"
+#include "extlib/intmap.h"
+#include "extlib/map.h"
+#include "extlib/sort.h"
+#include "extlib/string.h"
+#include "extlib/typedmap.h"
+#include "extlib/vector.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// HARNESS
+// -----------------------------------------------------------------------------
+
+typedef struct bench_ctx {
+    double start;
+    double elapsed;  // Seconds spent in the measured section of the current run
+    size_t ops;      // Operations performed in the measured section
+    size_t bytes;    // Bytes processed in the measured section, 0 if not meaningful
+} bench_ctx;
+
+typedef void (*bench_fn)(bench_ctx* ctx, const void* arg);
+
+static int reps = 5;
+static double scale = 1.0;
+static char** filters;
+static int num_filters;
+static bool first_result = true;
+
+// Results of benchmarks are accumulated here, so that the compiler can't optimize them away
+static volatile uint64_t sink;
+
+static double now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+#ifndef _WIN32
+static size_t rusage_rss_kb(const struct rusage* usage) {
+    #ifdef __APPLE__
+    return usage->ru_maxrss / 1024;  // Bytes on macOS
+    #else
+    return usage->ru_maxrss;
+    #endif
+}
+#endif
+
+static void bench_start(bench_ctx* ctx) {
+    ctx->start = now();
+}
+
+static void bench_stop(bench_ctx* ctx, size_t ops, size_t bytes) {
+    ctx->elapsed = now() - ctx->start;
+    ctx->ops = ops;
+    ctx->bytes = bytes;
+}
+
+static bool selected(const char* name) {
+    if(!num_filters) return true;
+    for(int i = 0; i < num_filters; i++) {
+        if(strstr(name, filters[i])) return true;
+    }
+    return false;
+}
+
+// Runs the benchmark `reps` times and returns the fastest run
+static bench_ctx run_reps(bench_fn fn, const void* arg) {
+    bench_ctx best = {0};
+    for(int i = 0; i < reps; i++) {
+        bench_ctx ctx = {0};
+        fn(&ctx, arg);
+        if(i == 0 || ctx.elapsed < best.elapsed) best = ctx;
+    }
+    return best;
+}
+
+// Runs the benchmark, measuring the peak resident memory it uses. Returns false on failure.
+static bool run_measured(bench_fn fn, const void* arg, bench_ctx* best, size_t* peak_rss_kb) {
+#ifdef _WIN32
+    *best = run_reps(fn, arg);
+    PROCESS_MEMORY_COUNTERS pmc;
+    *peak_rss_kb = GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))
+                       ? pmc.PeakWorkingSetSize / 1024
+                       : 0;
+    return true;
+#else
+    int fds[2];
+    if(pipe(fds)) return false;
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if(pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if(pid == 0) {
+        close(fds[0]);
+        bench_ctx ctx = run_reps(fn, arg);
+        ssize_t written = write(fds[1], &ctx, sizeof(ctx));
+        _exit(written == (ssize_t)sizeof(ctx) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], best, sizeof(*best));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) < 0) return false;
+    *peak_rss_kb = rusage_rss_kb(&usage);
+    return got == (ssize_t)sizeof(*best) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// Runs the benchmark and prints its fastest run. `extra` is a (possibly empty) list of additional
+// JSON fields describing the parameters of the benchmark.
+static void run(const char* name, bench_fn fn, const void* arg, const char* extra) {
+    if(!selected(name)) return;
+
+    bench_ctx best;
+    size_t peak_rss_kb;
+    if(!run_measured(fn, arg, &best, &peak_rss_kb)) {
+        fprintf(stderr, "benchmark %s failed\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    double ns_per_op = best.ops ? best.elapsed * 1e9 / best.ops : 0;
+    double ops_per_sec = best.elapsed > 0 ? best.ops / best.elapsed : 0;
+    double mb_per_sec = best.elapsed > 0 ? best.bytes / best.elapsed / (1024 * 1024) : 0;
+
+    printf("%s\n    {\"name\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f",
+           first_result ? "" : ",", name, best.ops, ns_per_op, ops_per_sec);
+    if(best.bytes) printf(", \"mb_per_sec\": %.1f", mb_per_sec);
+    printf(", \"peak_rss_kb\": %zu%s%s}", peak_rss_kb, *extra ? ", " : "", extra);
+    fflush(stdout);
+    first_result = false;
+}
+
+static size_t scaled(size_t n) {
+    size_t s = n * scale;
+    return s ? s : 1;
+}
+
+// splitmix64: a bijection, so distinct inputs always generate distinct keys
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+typedef struct rng {
+    uint64_t state;
+} rng;
+
+static uint64_t rng_next(rng* r) {
+    return mix(r->state++);
+}
+
+// -----------------------------------------------------------------------------
+// MAP
+// -----------------------------------------------------------------------------
+
+// Entries have a 64-bit key at offset 0, followed by a payload to reach the desired size
+typedef struct map_params {
+    size_t entry_sz;
+    double load;  // Target load factor
+} map_params;
+
+static uint32_t entry_hash(const void* e) {
+    uint64_t key;
+    memcpy(&key, e, sizeof(key));
+    return ext_map_hash_u64(key);
+}
+
+static bool entry_compare(const void* e1, const void* e2) {
+    return memcmp(e1, e2, sizeof(uint64_t)) == 0;
+}
+
+static void make_entry(char* entry, size_t entry_sz, uint64_t key) {
+    memset(entry, 0, entry_sz);
+    memcpy(entry, &key, sizeof(key));
+}
+
+// Number of entries that make a map of about 1M slots (at a scale of 1) reach the target load
+static size_t map_entries(const map_params* p) {
+    size_t capacity = 1024;
+    while(capacity * 2 <= scaled((size_t)1 << 20)) capacity *= 2;
+    return capacity * p->load;
+}
+
+static ext_map* build_map(const map_params* p, size_t n) {
+    ext_map* map = ext_map_new(p->entry_sz, entry_hash, entry_compare);
+    char entry[256];
+    for(size_t i = 0; i < n; i++) {
+        make_entry(entry, p->entry_sz, mix(i));
+        ext_map_put(map, entry);
+    }
+    return map;
+}
+
+static void map_extra(char* buf, size_t size, const map_params* p, const ext_map* map) {
+    snprintf(buf, size, "\"entry_size\": %zu, \"entries\": %zu, \"load_factor\": %.3f", p->entry_sz,
+             ext_map_size(map), (double)ext_map_size(map) / ext_map_capacity(map));
+}
+
+static void bench_map_put(bench_ctx* ctx, const void* arg) {
+    const map_params* p = arg;
+    size_t n = map_entries(p);
+    bench_start(ctx);
+    ext_map* map = build_map(p, n);
+    bench_stop(ctx, n, 0);
+    ext_map_free(map);
+}
+
+static void bench_map_lookup(bench_ctx* ctx, const map_params* p, bool hit) {
+    size_t n = map_entries(p);
+    ext_map* map = build_map(p, n);
+
+    // Look up keys in a random order, so that the benchmark isn't dominated by the cache
+    size_t lookups = scaled(2000000);
+    uint64_t* keys = malloc(lookups * sizeof(*keys));
+    rng r = {42};
+    for(size_t i = 0; i < lookups; i++) {
+        size_t idx = rng_next(&r) % n;
+        keys[i] = hit ? mix(idx) : mix(idx + n);
+    }
+
+    char entry[256];
+    make_entry(entry, p->entry_sz, 0);
+    size_t found = 0;
+    bench_start(ctx);
+    for(size_t i = 0; i < lookups; i++) {
+        memcpy(entry, &keys[i], sizeof(keys[i]));
+        found += ext_map_get(map, entry) != NULL;
+    }
+    bench_stop(ctx, lookups, 0);
+    sink += found;
+
+    free(keys);
+    ext_map_free(map);
+}
+
+static void bench_map_hit(bench_ctx* ctx, const void* arg) {
+    bench_map_lookup(ctx, arg, true);
+}
+
+static void bench_map_miss(bench_ctx* ctx, const void* arg) {
+    bench_map_lookup(ctx, arg, false);
+}
+
+// Erases the oldest entry and inserts a new one, keeping the size of the map constant
+static void bench_map_churn(bench_ctx* ctx, const void* arg) {
+    const map_params* p = arg;
+    size_t n = map_entries(p);
+    ext_map* map = build_map(p, n);
+
+    size_t ops = scaled(2000000);
+    char entry[256];
+    make_entry(entry, p->entry_sz, 0);
+    bench_start(ctx);
+    for(size_t i = 0; i < ops; i++) {
+        uint64_t old_key = mix(i), new_key = mix(i + n);
+        memcpy(entry, &old_key, sizeof(old_key));
+        ext_map_erase(map, entry);
+        memcpy(entry, &new_key, sizeof(new_key));
+        ext_map_put(map, entry);
+    }
+    bench_stop(ctx, ops, 0);
+
+    ext_map_free(map);
+}
+
+static void map_benchmarks(void) {
+    // Load factors right after growing, halfway, and right before growing
+    static const double loads[] = {0.38, 0.56, 0.74};
+    static const size_t sizes[] = {8, 16, 64};
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        for(size_t l = 0; l < sizeof(loads) / sizeof(*loads); l++) {
+            map_params p = {sizes[s], loads[l]};
+            ext_map* map = build_map(&p, map_entries(&p));
+            char extra[128], name[64];
+            map_extra(extra, sizeof(extra), &p, map);
+            ext_map_free(map);
+
+            snprintf(name, sizeof(name), "map/put/%zuB/lf%.2f", p.entry_sz, p.load);
+            run(name, bench_map_put, &p, extra);
+            snprintf(name, sizeof(name), "map/hit/%zuB/lf%.2f", p.entry_sz, p.load);
+            run(name, bench_map_hit, &p, extra);
+            snprintf(name, sizeof(name), "map/miss/%zuB/lf%.2f", p.entry_sz, p.load);
+            run(name, bench_map_miss, &p, extra);
+            snprintf(name, sizeof(name), "map/churn/%zuB/lf%.2f", p.entry_sz, p.load);
+            run(name, bench_map_churn, &p, extra);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// INTMAP
+// -----------------------------------------------------------------------------
+
+// ID -> index maps, comparing ext_intmap to the generic typed map declared with EXT_MAP_DECLARE
+
+EXT_INTMAP_DECLARE(id_intmap, uint64_t, uint64_t)
+EXT_MAP_DECLARE(id_typedmap, uint64_t, uint64_t, ext_map_hash_u64, ext_map_eq)
+
+typedef struct intmap_params {
+    double load;
+    bool reference;  // Use the typed map instead of ext_intmap
+} intmap_params;
+
+static size_t intmap_entries(const intmap_params* p) {
+    map_params mp = {16, p->load};
+    return map_entries(&mp);
+}
+
+// Builds both maps, as they grow at the same load factor this keeps the code simple
+static void build_intmaps(size_t n, id_intmap* map, id_typedmap* ref) {
+    for(size_t i = 0; i < n; i++) {
+        if(map) id_intmap_put(map, mix(i), i);
+        if(ref) id_typedmap_put(ref, mix(i), i);
+    }
+}
+
+static void bench_intmap_put(bench_ctx* ctx, const void* arg) {
+    const intmap_params* p = arg;
+    size_t n = intmap_entries(p);
+    id_intmap map = {0};
+    id_typedmap ref = {0};
+    bench_start(ctx);
+    build_intmaps(n, p->reference ? NULL : &map, p->reference ? &ref : NULL);
+    bench_stop(ctx, n, 0);
+    id_intmap_free(&map);
+    id_typedmap_free(&ref);
+}
+
+static void bench_intmap_lookup(bench_ctx* ctx, const intmap_params* p, bool hit) {
+    size_t n = intmap_entries(p);
+    id_intmap map = {0};
+    id_typedmap ref = {0};
+    build_intmaps(n, p->reference ? NULL : &map, p->reference ? &ref : NULL);
+
+    size_t lookups = scaled(2000000);
+    uint64_t* keys = malloc(lookups * sizeof(*keys));
+    rng r = {42};
+    for(size_t i = 0; i < lookups; i++) {
+        size_t idx = rng_next(&r) % n;
+        keys[i] = hit ? mix(idx) : mix(idx + n);
+    }
+
+    size_t found = 0;
+    bench_start(ctx);
+    if(p->reference) {
+        for(size_t i = 0; i < lookups; i++) found += id_typedmap_get(&ref, keys[i]) != NULL;
+    } else {
+        for(size_t i = 0; i < lookups; i++) found += id_intmap_get(&map, keys[i]) != NULL;
+    }
+    bench_stop(ctx, lookups, 0);
+    sink += found;
+
+    free(keys);
+    id_intmap_free(&map);
+    id_typedmap_free(&ref);
+}
+
+static void bench_intmap_hit(bench_ctx* ctx, const void* arg) {
+    bench_intmap_lookup(ctx, arg, true);
+}
+
+static void bench_intmap_miss(bench_ctx* ctx, const void* arg) {
+    bench_intmap_lookup(ctx, arg, false);
+}
+
+static void intmap_benchmarks(void) {
+    static const double loads[] = {0.38, 0.56, 0.74};
+    for(size_t l = 0; l < sizeof(loads) / sizeof(*loads); l++) {
+        for(int ref = 0; ref <= 1; ref++) {
+            intmap_params p = {loads[l], ref};
+            const char* suffix = ref ? "/ref_typedmap" : "";
+            char extra[64], name[64];
+            snprintf(extra, sizeof(extra), "\"entries\": %zu", intmap_entries(&p));
+
+            snprintf(name, sizeof(name), "intmap/put/lf%.2f%s", p.load, suffix);
+            run(name, bench_intmap_put, &p, extra);
+            snprintf(name, sizeof(name), "intmap/hit/lf%.2f%s", p.load, suffix);
+            run(name, bench_intmap_hit, &p, extra);
+            snprintf(name, sizeof(name), "intmap/miss/lf%.2f%s", p.load, suffix);
+            run(name, bench_intmap_miss, &p, extra);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// STRING
+// -----------------------------------------------------------------------------
+
+// The corpus is pseudo-english text: words drawn from a vocabulary with a skewed distribution,
+// grouped in lines of varying length
+static const char* const vocabulary[] = {
+    "the",     "of",       "and",       "to",        "in",          "is",       "that",
+    "for",     "it",       "as",        "was",       "with",        "be",       "by",
+    "on",      "not",      "he",        "this",      "are",         "or",       "his",
+    "from",    "at",       "which",     "but",       "have",        "an",       "had",
+    "they",    "you",      "were",      "their",     "one",         "all",      "we",
+    "can",     "her",      "has",       "there",     "been",        "if",       "more",
+    "when",    "will",     "would",     "who",       "so",          "no",       "system",
+    "memory",  "request",  "response",  "hashtable", "performance", "benchmark", "allocation",
+    "growing", "vector",   "string",    "pointer",   "structure",   "algorithm", "implementation",
+};
+
+#define VOCABULARY_SIZE (sizeof(vocabulary) / sizeof(*vocabulary))
+
+static ext_string corpus;
+
+static ext_string make_corpus(size_t size) {
+    ext_string text = ext_str_new_cap(size);
+    rng r = {7};
+    size_t words_in_line = 0;
+    while(ext_str_size(text) < size) {
+        // Square the random number to favour the first (more common) words
+        double x = (double)(rng_next(&r) >> 11) / (1ull << 53);
+        ext_str_append(&text, vocabulary[(size_t)(x * x * VOCABULARY_SIZE)]);
+        if(++words_in_line > 4 + rng_next(&r) % 12) {
+            ext_str_append(&text, "\n");
+            words_in_line = 0;
+        } else {
+            ext_str_append(&text, " ");
+        }
+    }
+    return text;
+}
+
+typedef enum {
+    FIND_FORWARD,     // ext_str_find
+    FIND_BACKWARD,    // ext_str_rfind, visiting the matches from the end
+    FIND_REF_STRSTR,  // strstr
+    FIND_REF_MEMCMP,  // memcmp at every offset, the simplest possible search
+} find_kind;
+
+typedef struct find_params {
+    const char* needle;
+    find_kind kind;
+} find_params;
+
+static size_t find_all_memcmp(const char* hay, size_t n, const char* needle, size_t len) {
+    size_t matches = 0;
+    for(size_t i = 0; i + len <= n; i++) {
+        if(memcmp(hay + i, needle, len) == 0) {
+            matches++;
+            i += len - 1;
+        }
+    }
+    return matches;
+}
+
+static void bench_str_find(bench_ctx* ctx, const void* arg) {
+    const find_params* p = arg;
+    size_t len = strlen(p->needle);
+    size_t size = ext_str_size(corpus);
+    size_t matches = 0, scanned = 0, searches = 0;
+
+    bench_start(ctx);
+    while(scanned < scaled(64 * 1024 * 1024)) {
+        switch(p->kind) {
+        case FIND_FORWARD: {
+            size_t pos = 0;
+            while((pos = ext_str_find_len(corpus, pos, p->needle, len)) != ext_str_npos) {
+                matches++;
+                pos += len;
+            }
+            break;
+        }
+        case FIND_BACKWARD: {
+            // rfind takes the start position as an offset from the end of the string
+            size_t from_end = 0, pos;
+            while((pos = ext_str_rfind_len(corpus, from_end, p->needle, len)) != ext_str_npos) {
+                matches++;
+                if(pos < len) break;
+                from_end = size - pos + len - 1;  // The next match must end before this one
+            }
+            break;
+        }
+        case FIND_REF_STRSTR:
+            for(const char* s = corpus; (s = strstr(s, p->needle)); s += len) matches++;
+            break;
+        case FIND_REF_MEMCMP:
+            matches += find_all_memcmp(corpus, size, p->needle, len);
+            break;
+        }
+        scanned += size;
+        searches++;
+    }
+    bench_stop(ctx, searches, scanned);
+    sink += matches;
+}
+
+static void bench_str_find_char(bench_ctx* ctx, const void* arg) {
+    bool reference = *(const bool*)arg;
+    size_t matches = 0, scanned = 0, searches = 0;
+    size_t size = ext_str_size(corpus);
+
+    bench_start(ctx);
+    while(scanned < scaled(64 * 1024 * 1024)) {
+        // Rare character, so that the search is dominated by scanning
+        if(reference) {
+            for(const char* s = corpus; (s = memchr(s, 'z', size - (s - corpus))); s++) matches++;
+        } else {
+            size_t pos = 0;
+            while((pos = ext_str_find_char(corpus, pos, 'z')) != ext_str_npos) {
+                matches++;
+                pos++;
+            }
+        }
+        scanned += size;
+        searches++;
+    }
+    bench_stop(ctx, searches, scanned);
+    sink += matches;
+}
+
+static void bench_str_split(bench_ctx* ctx, const void* arg) {
+    bool views = *(const bool*)arg;
+    size_t lines = 0;
+
+    bench_start(ctx);
+    if(views) {
+        ext_vector(ext_strview) fields = ext_str_split_view(corpus, '\n');
+        lines = ext_vec_size(fields);
+        ext_vec_free(fields);
+    } else {
+        ext_vector(ext_string) fields = ext_str_split(corpus, '\n');
+        lines = ext_vec_size(fields);
+        ext_vec_foreach(ext_string* s, fields) {
+            ext_str_free(*s);
+        }
+        ext_vec_free(fields);
+    }
+    bench_stop(ctx, lines, ext_str_size(corpus));
+    sink += lines;
+}
+
+static void bench_str_tokenize(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    size_t words = 0;
+    bench_start(ctx);
+    ext_strtok tok = ext_strtok_new(ext_str_view(corpus), ' ');
+    ext_strview field;
+    while(ext_strtok_next(&tok, &field)) words++;
+    bench_stop(ctx, words, ext_str_size(corpus));
+    sink += words;
+}
+
+// Builds a big string out of the words of the vocabulary, exercising the growth of the string
+static void bench_str_append(bench_ctx* ctx, const void* arg) {
+    bool builder = *(const bool*)arg;
+    size_t appends = scaled(4000000), bytes = 0;
+
+    bench_start(ctx);
+    if(builder) {
+        ext_strbuilder sb = {0};
+        for(size_t i = 0; i < appends; i++) {
+            const char* word = vocabulary[i % VOCABULARY_SIZE];
+            ext_strbuilder_append(&sb, word);
+        }
+        ext_string str = ext_strbuilder_to_str(&sb);
+        bytes = ext_str_size(str);
+        ext_str_free(str);
+        ext_strbuilder_free(&sb);
+    } else {
+        ext_string str = ext_str_new("");
+        for(size_t i = 0; i < appends; i++) {
+            ext_str_append(&str, vocabulary[i % VOCABULARY_SIZE]);
+        }
+        bytes = ext_str_size(str);
+        ext_str_free(str);
+    }
+    bench_stop(ctx, appends, bytes);
+}
+
+static void bench_str_append_int(bench_ctx* ctx, const void* arg) {
+    bool reference = *(const bool*)arg;
+    size_t appends = scaled(2000000);
+    rng r = {3};
+
+    ext_string str = ext_str_new_cap(appends * 21);
+    bench_start(ctx);
+    for(size_t i = 0; i < appends; i++) {
+        int64_t n = (int64_t)rng_next(&r) >> (i % 64);
+        if(reference) {
+            ext_str_append_fmt(&str, "%lld", (long long)n);
+        } else {
+            ext_str_append_int(&str, n);
+        }
+    }
+    bench_stop(ctx, appends, ext_str_size(str));
+    ext_str_free(str);
+}
+
+static void string_benchmarks(void) {
+    corpus = make_corpus(scaled(8 * 1024 * 1024));
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"corpus_size\": %zu", ext_str_size(corpus));
+
+    static const char* const needles[] = {
+        "system",
+        "hashtable performance",
+        "implementation of the allocation",
+        "request response vector pointer structure algorithm",
+        "the structure of the implementation of the hashtable vector",
+    };
+    static const char* const suffixes[] = {"", "/rfind", "/ref_strstr", "/ref_memcmp"};
+    for(size_t i = 0; i < sizeof(needles) / sizeof(*needles); i++) {
+        for(int kind = FIND_FORWARD; kind <= FIND_REF_MEMCMP; kind++) {
+            find_params p = {needles[i], kind};
+            char name[96], find_extra[160];
+            snprintf(name, sizeof(name), "str/find/%zuB%s", strlen(p.needle), suffixes[kind]);
+            snprintf(find_extra, sizeof(find_extra), "%s, \"needle\": \"%s\"", extra, p.needle);
+            run(name, bench_str_find, &p, find_extra);
+        }
+    }
+
+    static const bool no = false, yes = true;
+    run("str/find_char", bench_str_find_char, &no, extra);
+    run("str/find_char/ref_memchr", bench_str_find_char, &yes, extra);
+    run("str/split", bench_str_split, &no, extra);
+    run("str/split_view", bench_str_split, &yes, extra);
+    run("str/tokenize", bench_str_tokenize, &no, extra);
+    run("str/append", bench_str_append, &no, "");
+    run("str/append/strbuilder", bench_str_append, &yes, "");
+    run("str/append_int", bench_str_append_int, &no, "");
+    run("str/append_int/ref_printf", bench_str_append_int, &yes, "");
+
+    ext_str_free(corpus);
+}
+
+// -----------------------------------------------------------------------------
+// VECTOR
+// -----------------------------------------------------------------------------
+
+EXT_SORT_DECLARE(u64, uint64_t, ext_sort_less)
+
+static void bench_vec_push_back(bench_ctx* ctx, const void* arg) {
+    bool reserve = *(const bool*)arg;
+    size_t n = scaled(20000000);
+    uint64_t* vec = NULL;
+
+    bench_start(ctx);
+    if(reserve) ext_vec_reserve(vec, n);
+    for(size_t i = 0; i < n; i++) {
+        ext_vec_push_back(vec, i);
+    }
+    bench_stop(ctx, n, n * sizeof(*vec));
+
+    sink += vec[n / 2];
+    ext_vec_free(vec);
+}
+
+static void bench_vec_append_n(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    uint64_t chunk[64] = {0};
+    size_t n = scaled(1000000);
+    uint64_t* vec = NULL;
+
+    bench_start(ctx);
+    for(size_t i = 0; i < n; i++) {
+        ext_vec_append_n(vec, chunk, 1 + i % 64);
+    }
+    bench_stop(ctx, n, ext_vec_size(vec) * sizeof(*vec));
+
+    ext_vec_free(vec);
+}
+
+// Inserts and erases at random positions of a vector of constant size
+static void bench_vec_insert_erase(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    size_t size = 10000, n = scaled(200000);
+    uint64_t* vec = NULL;
+    for(size_t i = 0; i < size; i++) ext_vec_push_back(vec, i);
+    rng r = {11};
+
+    bench_start(ctx);
+    for(size_t i = 0; i < n; i++) {
+        size_t insert_pos = rng_next(&r) % size, erase_pos = rng_next(&r) % size;
+        ext_vec_insert(vec, insert_pos, i);
+        ext_vec_erase(vec, erase_pos);
+    }
+    bench_stop(ctx, 2 * n, 0);
+
+    ext_vec_free(vec);
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef enum { SORT_INTRO, SORT_RADIX, SORT_QSORT } sort_kind;
+
+static void bench_vec_sort(bench_ctx* ctx, const void* arg) {
+    sort_kind kind = *(const sort_kind*)arg;
+    size_t n = scaled(5000000);
+    uint64_t* vec = NULL;
+    rng r = {5};
+    for(size_t i = 0; i < n; i++) ext_vec_push_back(vec, rng_next(&r));
+
+    bench_start(ctx);
+    switch(kind) {
+    case SORT_INTRO:
+        ext_vec_sort(vec, u64);
+        break;
+    case SORT_RADIX:
+        ext_vec_radix_sort(vec, u64);
+        break;
+    case SORT_QSORT:
+        qsort(vec, n, sizeof(*vec), cmp_u64);
+        break;
+    }
+    bench_stop(ctx, n, n * sizeof(*vec));
+
+    sink += vec[0];
+    ext_vec_free(vec);
+}
+
+static void vector_benchmarks(void) {
+    static const bool no = false, yes = true;
+    run("vec/push_back", bench_vec_push_back, &no, "\"element_size\": 8");
+    run("vec/push_back/reserved", bench_vec_push_back, &yes, "\"element_size\": 8");
+    run("vec/append_n", bench_vec_append_n, NULL, "\"element_size\": 8");
+    run("vec/insert_erase", bench_vec_insert_erase, NULL, "\"element_size\": 8, \"size\": 10000");
+
+    static const sort_kind intro = SORT_INTRO, radix = SORT_RADIX, ref = SORT_QSORT;
+    run("vec/sort", bench_vec_sort, &intro, "\"element_size\": 8");
+    run("vec/sort/radix", bench_vec_sort, &radix, "\"element_size\": 8");
+    run("vec/sort/ref_qsort", bench_vec_sort, &ref, "\"element_size\": 8");
+}
+
+// -----------------------------------------------------------------------------
+// BTREE
+// -----------------------------------------------------------------------------
+
+// Trees of 64-bit keys, built either one key at a time in random order or from a sorted vector
+
+#define BTREE_SCAN 100  // Entries visited after every lookup by btree/range
+
+static size_t btree_entries(void) {
+    return scaled(1000000);
+}
+
+static uint64_t* sorted_keys(size_t n) {
+    uint64_t* keys = NULL;
+    ext_vec_reserve(keys, n);
+    for(size_t i = 0; i < n; i++) ext_vec_push_back(keys, mix(i));
+    ext_vec_radix_sort(keys, u64);
+    return keys;
+}
+
+static void bench_btree_put(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    size_t n = btree_entries();
+    ext_btree* tree = ext_btree_new(sizeof(uint64_t), cmp_u64);
+    bench_start(ctx);
+    for(size_t i = 0; i < n; i++) {
+        uint64_t key = mix(i);
+        ext_btree_put(tree, &key);
+    }
+    bench_stop(ctx, n, 0);
+    ext_btree_free(tree);
+}
+
+static void bench_btree_load_sorted(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    size_t n = btree_entries();
+    uint64_t* keys = sorted_keys(n);
+    ext_btree* tree = ext_btree_new(sizeof(uint64_t), cmp_u64);
+    bench_start(ctx);
+    ext_btree_load_vec(tree, keys);
+    bench_stop(ctx, n, 0);
+    ext_btree_free(tree);
+    ext_vec_free(keys);
+}
+
+// Looks up random keys. With a non-zero `scan`, visits the `scan` entries following each of them.
+static void bench_btree_lookup(bench_ctx* ctx, size_t scan) {
+    size_t n = btree_entries();
+    uint64_t* keys = sorted_keys(n);
+    ext_btree* tree = ext_btree_new(sizeof(uint64_t), cmp_u64);
+    ext_btree_load_vec(tree, keys);
+
+    size_t lookups = scaled(scan ? 200000 : 2000000);
+    uint64_t* queries = malloc(lookups * sizeof(*queries));
+    rng r = {7};
+    for(size_t i = 0; i < lookups; i++) queries[i] = mix(rng_next(&r) % n);
+
+    uint64_t found = 0;
+    bench_start(ctx);
+    for(size_t i = 0; i < lookups; i++) {
+        if(!scan) {
+            found += ext_btree_get(tree, &queries[i]) != NULL;
+            continue;
+        }
+        ext_btree_it it = ext_btree_lower_bound(tree, &queries[i]);
+        for(size_t j = 0; j < scan && it.entry; j++, ext_btree_next(&it)) {
+            found += *(const uint64_t*)it.entry;
+        }
+    }
+    bench_stop(ctx, lookups, 0);
+    sink += found;
+
+    free(queries);
+    ext_btree_free(tree);
+    ext_vec_free(keys);
+}
+
+static void bench_btree_get(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    bench_btree_lookup(ctx, 0);
+}
+
+static void bench_btree_range(bench_ctx* ctx, const void* arg) {
+    (void)arg;
+    bench_btree_lookup(ctx, BTREE_SCAN);
+}
+
+static void btree_benchmarks(void) {
+    char extra[64], range_extra[80];
+    snprintf(extra, sizeof(extra), "\"entries\": %zu", btree_entries());
+    snprintf(range_extra, sizeof(range_extra), "%s, \"scan\": %d", extra, BTREE_SCAN);
+
+    run("btree/put", bench_btree_put, NULL, extra);
+    run("btree/load_sorted", bench_btree_load_sorted, NULL, extra);
+    run("btree/get", bench_btree_get, NULL, extra);
+    run("btree/range", bench_btree_range, NULL, range_extra);
+}
+
+// -----------------------------------------------------------------------------
+// MAIN
+// -----------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+    filters = malloc(argc * sizeof(*filters));
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+            if(reps < 1) reps = 1;
+        } else if(strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+            if(scale <= 0) scale = 1.0;
+        } else {
+            filters[num_filters++] = argv[i];
+        }
+    }
+
+    printf("{\n  \"reps\": %d,\n  \"scale\": %g,\n  \"benchmarks\": [", reps, scale);
+    vector_benchmarks();
+    string_benchmarks();
+    map_benchmarks();
+    intmap_benchmarks();
+    btree_benchmarks();
+    printf("\n  ]\n}\n");
+
+    free(filters);
+    return 0;
+}
@@ -1,4 +1,5 @@
 include(CMakeFindDependencyMacro)
+find_dependency(Threads)
 include("${CMAKE_CURRENT_LIST_DIR}/ExtlibConfigVersion.cmake")
 include("${CMAKE_CURRENT_LIST_DIR}/ExtlibTargets.cmake")
 message(STATUS "Found extlib version ${PACKAGE_VERSION}")
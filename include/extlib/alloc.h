@@ -0,0 +1,52 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdlib.h>
+
+// Allocation functions used by all containers of the library. They can be globally overridden at
+// compile time by defining these macros (for example in the build system) with functions having
+// the same signature of malloc, realloc and free.
+#ifndef EXT_MALLOC
+    #define EXT_MALLOC malloc
+#endif
+#ifndef EXT_REALLOC
+    #define EXT_REALLOC realloc
+#endif
+#ifndef EXT_FREE
+    #define EXT_FREE free
+#endif
+
+// Custom allocator interface, that can be set on a per-container basis at runtime.
+// Other than the pointer, `realloc` and `free` receive the size of the allocation, so that
+// allocators that don't keep track of it (such as arenas) can be easily implemented.
+// `ctx` is passed as is to all functions.
+typedef struct ext_allocator {
+    void* (*alloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+    void (*free)(void* ctx, void* ptr, size_t size);
+    void* ctx;
+} ext_allocator;
+
+// Allocate, reallocate and free using `allocator`. A NULL allocator means the default one, i.e.
+// EXT_MALLOC, EXT_REALLOC and EXT_FREE.
+
+static inline void* ext_alloc(const ext_allocator* allocator, size_t size) {
+    return allocator ? allocator->alloc(allocator->ctx, size) : EXT_MALLOC(size);
+}
+
+static inline void* ext_realloc(const ext_allocator* allocator, void* ptr, size_t old_size,
+                                size_t new_size) {
+    if(!allocator) return EXT_REALLOC(ptr, new_size);
+    return allocator->realloc(allocator->ctx, ptr, old_size, new_size);
+}
+
+static inline void ext_free(const ext_allocator* allocator, void* ptr, size_t size) {
+    if(!ptr) return;
+    if(allocator) {
+        allocator->free(allocator->ctx, ptr, size);
+    } else {
+        EXT_FREE(ptr);
+    }
+}
+
+#endif  // ALLOC_H
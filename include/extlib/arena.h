@@ -0,0 +1,59 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+#include "extlib/alloc.h"
+
+// A chunked bump allocator. Allocations are carved sequentially out of big chunks of memory, and
+// are never released individually: the whole arena is released at once by resetting it, or up
+// to a previously taken mark by rewinding it. Chunks are kept around and reused after a reset, so
+// an arena that is reset on every iteration of a loop quickly stops calling malloc altogether.
+// All allocations are aligned to EXT_ARENA_ALIGNMENT bytes.
+
+#define EXT_ARENA_ALIGNMENT  16
+#define EXT_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct ext_arena ext_arena;
+
+// A position in the arena, that can be later restored with ext_arena_rewind
+typedef struct ext_arena_mark {
+    void* chunk;
+    size_t used;
+} ext_arena_mark;
+
+// Creates a new arena that allocates chunks of `chunk_size` bytes, or EXT_ARENA_CHUNK_SIZE if 0.
+// Bigger allocations get a chunk of their own.
+ext_arena* ext_arena_new(size_t chunk_size);
+// Frees the arena and all memory allocated from it
+void ext_arena_free(ext_arena* arena);
+
+void* ext_arena_alloc(ext_arena* arena, size_t size);
+// Grows or shrinks an allocation. If `ptr` is the last allocation made from the arena it is
+// resized in place when possible, otherwise a new block is allocated and the contents copied.
+void* ext_arena_realloc(ext_arena* arena, void* ptr, size_t old_size, size_t new_size);
+
+ext_arena_mark ext_arena_get_mark(const ext_arena* arena);
+// Releases all allocations made after `mark` was taken
+void ext_arena_rewind(ext_arena* arena, ext_arena_mark mark);
+// Releases all allocations in O(1), keeping the chunks for reuse
+void ext_arena_reset(ext_arena* arena);
+
+// Returns an allocator that allocates from `arena`, to be used with containers. Freeing memory
+// through it is a no-op, except for the last allocation that is given back to the arena.
+// The allocator is valid for the lifetime of the arena.
+const ext_allocator* ext_arena_allocator(ext_arena* arena);
+
+// Arena-aware constructors. The created strings and vectors don't need to be freed: their memory
+// is released together with the arena. extlib/string.h and extlib/vector.h must be included to
+// use them.
+#define ext_arena_str_new(arena, cstring) \
+    ext_str_new_len_with_allocator(cstring, strlen(cstring), ext_arena_allocator(arena))
+#define ext_arena_str_new_len(arena, data, len) \
+    ext_str_new_len_with_allocator(data, len, ext_arena_allocator(arena))
+#define ext_arena_str_new_cap(arena, capacity) \
+    ext_str_new_cap_with_allocator(capacity, ext_arena_allocator(arena))
+#define ext_arena_vec_reserve(vec, amount, arena) \
+    ext_vec_reserve_with_allocator(vec, amount, ext_arena_allocator(arena))
+
+#endif  // ARENA_H
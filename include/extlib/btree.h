@@ -0,0 +1,72 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "extlib/alloc.h"
+
+// An ordered container of fixed size entries, with the same entry-based interface of ext_map.
+// Entries are ordered by a three-way comparison function, that must return a negative, zero or
+// positive value if `e1` is respectively less than, equal to or greater than `e2`.
+//
+// The tree is a B+tree: all entries are stored in the leaves, that are linked together so that
+// iterating over a range only follows a pointer every few dozen entries. Nodes span a handful of
+// cache lines, so that a lookup on a tree of millions of entries only touches 4 or 5 of them.
+//
+// Example:
+//     ext_btree* tree = ext_btree_new(sizeof(Event), event_compare);
+//     ext_btree_put(tree, &event);
+//
+//     // Visit all events in the [from, to) time range
+//     for(ext_btree_it it = ext_btree_lower_bound(tree, &from); it.entry; ext_btree_next(&it)) {
+//         const Event* e = it.entry;
+//         if(event_compare(e, &to) >= 0) break;
+//         ...
+//     }
+
+typedef int (*ext_btree_compare_fn)(const void* e1, const void* e2);
+
+typedef struct ext_btree ext_btree;
+
+ext_btree* ext_btree_new(size_t entry_sz, ext_btree_compare_fn compare);
+// Same as ext_btree_new, but the tree will use `allocator` for all its allocations
+ext_btree* ext_btree_new_with_allocator(size_t entry_sz, ext_btree_compare_fn compare,
+                                        const ext_allocator* allocator);
+void ext_btree_free(ext_btree* tree);
+
+const void* ext_btree_get(const ext_btree* tree, const void* entry);
+// Inserts `entry`, or replaces the equal one already in the tree. Returns true if it was inserted.
+bool ext_btree_put(ext_btree* tree, const void* entry);
+bool ext_btree_erase(ext_btree* tree, const void* entry);
+void ext_btree_clear(ext_btree* tree);
+
+// Builds the tree from `count` contiguous entries, that must be sorted in strictly increasing
+// order. The tree must be empty. Much faster than putting the entries one by one, as nodes are
+// filled in sequence, without any search or split.
+void ext_btree_load_sorted(ext_btree* tree, const void* entries, size_t count);
+// Same as ext_btree_load_sorted, on the entries of a sorted ext_vector
+#define ext_btree_load_vec(tree, vec) ext_btree_load_sorted(tree, vec, ext_vec_size(vec))
+
+size_t ext_btree_size(const ext_btree* tree);
+bool ext_btree_empty(const ext_btree* tree);
+
+// Iterators visit entries in increasing order. `entry` points to the current entry, and is NULL
+// once the iterator moves past the last one. Modifying the tree invalidates all iterators.
+typedef struct ext_btree_it {
+    const void* entry;
+    // Private
+    const ext_btree* tree_;
+    const void* leaf_;
+    size_t idx_;
+} ext_btree_it;
+
+// Returns an iterator to the first entry of the tree
+ext_btree_it ext_btree_begin(const ext_btree* tree);
+// Returns an iterator to the first entry not less than `entry`
+ext_btree_it ext_btree_lower_bound(const ext_btree* tree, const void* entry);
+// Returns an iterator to the first entry greater than `entry`
+ext_btree_it ext_btree_upper_bound(const ext_btree* tree, const void* entry);
+void ext_btree_next(ext_btree_it* it);
+
+#endif  // BTREE_H
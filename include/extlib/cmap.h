@@ -0,0 +1,45 @@
+#ifndef CMAP_H
+#define CMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "extlib/map.h"
+
+// A thread-safe hashmap with the same semantics of ext_map.
+// The map is split into a number of shards, each one an independent ext_map protected by its own
+// reader-writer lock. The shard of an entry is selected using the high bits of its hash, so most
+// operations on different keys never contend on the same lock.
+// As entries can be moved or erased by other threads at any time, lookups copy the found entry in a
+// caller-provided buffer instead of returning a pointer into the map.
+
+typedef struct ext_cmap ext_cmap;
+
+// Called by ext_cmap_foreach on every entry of the map
+typedef void (*ext_cmap_visit_fn)(const void* entry, void* ctx);
+
+// `num_shards` is rounded up to a power of two. Pass 0 to use the default number of shards.
+ext_cmap* ext_cmap_new(size_t entry_sz, hash_fn hash, compare_fn compare, size_t num_shards);
+void ext_cmap_free(ext_cmap* map);
+
+// Copies the entry equal to `entry` in `out` (if not NULL). Returns false if not found.
+bool ext_cmap_get(const ext_cmap* map, const void* entry, void* out);
+bool ext_cmap_put(ext_cmap* map, const void* entry);
+bool ext_cmap_erase(ext_cmap* map, const void* entry);
+void ext_cmap_clear(ext_cmap* map);
+
+// Visits all entries, one shard at a time. The visited shard is locked for reading during the
+// visit, so `fn` must not modify the map.
+void ext_cmap_foreach(const ext_cmap* map, ext_cmap_visit_fn fn, void* ctx);
+
+// Note that under concurrent modification the returned size is only a snapshot
+size_t ext_cmap_size(const ext_cmap* map);
+bool ext_cmap_empty(const ext_cmap* map);
+size_t ext_cmap_num_shards(const ext_cmap* map);
+
+// Instrumentation counters of all shards combined, see ext_map_stats
+ext_map_statistics ext_cmap_stats(const ext_cmap* map);
+void ext_cmap_reset_stats(ext_cmap* map);
+
+#endif  // CMAP_H
@@ -0,0 +1,33 @@
+#ifndef DMAP_H
+#define DMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "extlib/map.h"
+
+// A dense, insertion-ordered hashmap with the same interface of ext_map.
+// Entries are stored contiguously in insertion order and are looked up through a separate, compact
+// index table. Iteration visits the entries in insertion order and only costs O(size).
+// As with ext_map, any modification of the map invalidates iterators and pointers to its entries.
+
+typedef struct ext_dmap ext_dmap;
+
+ext_dmap* ext_dmap_new(size_t entry_sz, hash_fn hash, compare_fn compare);
+void ext_dmap_free(ext_dmap* map);
+
+const void* ext_dmap_get(const ext_dmap* map, const void* entry);
+bool ext_dmap_put(ext_dmap* map, const void* entry);
+bool ext_dmap_erase(ext_dmap* map, const void* entry);
+void ext_dmap_clear(ext_dmap* map);
+
+size_t ext_dmap_size(const ext_dmap* map);
+size_t ext_dmap_capacity(const ext_dmap* map);
+bool ext_dmap_empty(const ext_dmap* map);
+
+const void* ext_dmap_begin(const ext_dmap* map);
+const void* ext_dmap_end(const ext_dmap* map);
+const void* ext_dmap_incr(const ext_dmap* map, const void* it);
+
+#endif  // DMAP_H
@@ -0,0 +1,35 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// A string interning pool. Interning a string returns a canonical, NUL terminated copy of it that
+// is owned by the pool: interning equal strings always returns the same pointer, so interned
+// strings can be compared for equality by simply comparing the pointers.
+// Strings are stored in large chunks of memory, and are only released all at once when the pool
+// is cleared or freed. Pointers returned by the pool remain valid until then.
+
+typedef struct ext_intern ext_intern;
+
+ext_intern* ext_intern_new(void);
+// Frees the pool and all the strings interned in it
+void ext_intern_free(ext_intern* pool);
+
+// Returns the canonical copy of the string, adding it to the pool if not already present
+const char* ext_intern_len(ext_intern* pool, const void* data, size_t len);
+const char* ext_intern_cstr(ext_intern* pool, const char* cstring);
+
+// Returns the canonical copy of the string if present in the pool, NULL otherwise
+const char* ext_intern_lookup(const ext_intern* pool, const void* data, size_t len);
+
+// Releases all interned strings at once
+void ext_intern_clear(ext_intern* pool);
+
+// Returns the number of distinct strings in the pool
+size_t ext_intern_size(const ext_intern* pool);
+
+// Returns the length of a string returned by the pool, without scanning it
+size_t ext_interned_len(const char* interned);
+
+#endif  // INTERN_H
@@ -0,0 +1,338 @@
+#ifndef INTMAP_H
+#define INTMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+
+// Hashmaps and hashsets specialized for integer keys, in the same "poor man's templates" style of
+// ext_vector and typedmap.h:
+//  - EXT_INTMAP_DECLARE(name, K, V) declares a struct `name` mapping keys of integer type `K` to
+//    values of type `V`, plus a set of `static inline` functions operating on it.
+//  - EXT_INTSET_DECLARE(name, K) declares a set of keys of integer type `K`.
+//
+// Example:
+//     EXT_INTMAP_DECLARE(idmap, uint64_t, uint32_t)
+//
+//     idmap map = {0};  // A zero-initialized map is a valid map, the empty one
+//     idmap_put(&map, 10, 20);
+//     uint32_t* idx = idmap_get(&map, 10);
+//     idmap_free(&map);
+//
+// Differently from EXT_MAP_DECLARE there are no hash or equality functions to provide: keys are
+// hashed with a multiply-xorshift mixer and compared with `==`, both inlined in the lookups.
+// Slots hold keys and values side by side, and empty slots are marked by the key 0, so there's no
+// separate control array and a lookup touches a single cache line most of the time. The key 0
+// itself can still be stored: its entry is kept in the map struct, outside of the table.
+// Collisions are resolved by linear probing with backward-shift deletion, so no tombstones are
+// ever left behind.
+// Lookups of missing keys have to scan a whole run of full slots, that spans more memory than the
+// control bytes of EXT_MAP_DECLARE maps: for workloads dominated by misses prefer the latter.
+
+// Mixes the bits of `key`, so that the lowest ones can be used to index the table
+static inline size_t ext_intmap_hash_(uint64_t key) {
+    key ^= key >> 32;
+    key *= 0xd6e8feb86659fd93ull;
+    key ^= key >> 32;
+    return (size_t)key;
+}
+
+#define EXT_INTMAP_INITIAL_CAPACITY_ 16
+
+// Whether a table of `capacity` slots can hold `size` entries, keeping the load under 75%
+#define ext_intmap_fits_(size, capacity) ((size)*4 <= (capacity)*3)
+
+// Empties slot `i` of the table `slots` of `mask + 1` slots. The key of slot `j` is
+// `slots[j] member`. Backward-shift deletion: following entries that can be moved closer to their
+// ideal slot are moved back, until an empty slot is found.
+#define ext_intmap_erase_slot_(slots, mask, i, member)                               \
+    do {                                                                              \
+        size_t __i = (i);                                                             \
+        for(size_t __j = (__i + 1) & (mask); (slots)[__j] member != 0;                \
+            __j = (__j + 1) & (mask)) {                                               \
+            size_t __home = ext_intmap_hash_((uint64_t)(slots)[__j] member) & (mask); \
+            if(((__j - __home) & (mask)) >= ((__j - __i) & (mask))) {                 \
+                (slots)[__i] = (slots)[__j];                                          \
+                __i = __j;                                                            \
+            }                                                                         \
+        }                                                                             \
+        memset(&(slots)[__i], 0, sizeof((slots)[__i]));                               \
+    } while(0)
+
+#define EXT_INTMAP_DECLARE(name, K, V)                                                             \
+    typedef struct name##_entry {                                                                  \
+        K key;                                                                                     \
+        V value;                                                                                   \
+    } name##_entry;                                                                                \
+                                                                                                   \
+    typedef struct name {                                                                          \
+        size_t capacity_mask, size;                                                                \
+        name##_entry* entries; /* A slot is empty if its key is 0 */                               \
+        bool has_zero;                                                                             \
+        name##_entry zero; /* The entry of key 0, valid if `has_zero` */                           \
+    } name;                                                                                        \
+                                                                                                   \
+    static inline void name##_free(name* map) {                                                    \
+        EXT_FREE(map->entries);                                                                    \
+        memset(map, 0, sizeof(*map));                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_size(const name* map) {                                            \
+        return map->size;                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_capacity(const name* map) {                                        \
+        return map->entries ? map->capacity_mask + 1 : 0;                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_empty(const name* map) {                                             \
+        return map->size == 0;                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns the index of `key` (that must not be 0), or of the empty slot where it should be */ \
+    /* inserted */                                                                                 \
+    static inline size_t name##_find_(const name* map, K key) {                                    \
+        size_t idx = ext_intmap_hash_((uint64_t)key) & map->capacity_mask;                         \
+        while(map->entries[idx].key != key && map->entries[idx].key != 0) {                        \
+            idx = (idx + 1) & map->capacity_mask;                                                  \
+        }                                                                                          \
+        return idx;                                                                                \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_rehash_(name* map, size_t new_cap) {                                 \
+        size_t old_cap = name##_capacity(map);                                                     \
+        name##_entry* old_entries = map->entries;                                                  \
+                                                                                                   \
+        map->entries = EXT_MALLOC(new_cap * sizeof(*map->entries));                                \
+        ASSERT(map->entries, "Out of memory");                                                     \
+        memset(map->entries, 0, new_cap * sizeof(*map->entries));                                  \
+        map->capacity_mask = new_cap - 1;                                                          \
+                                                                                                   \
+        for(size_t i = 0; i < old_cap; i++) {                                                      \
+            if(old_entries[i].key != 0) {                                                          \
+                map->entries[name##_find_(map, old_entries[i].key)] = old_entries[i];              \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        EXT_FREE(old_entries);                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    /* Makes room for at least `amount` entries, so that inserting them won't rehash the map */    \
+    static inline void name##_reserve(name* map, size_t amount) {                                  \
+        size_t cap = name##_capacity(map);                                                         \
+        if(ext_intmap_fits_(amount, cap)) return;                                                  \
+        if(!cap) cap = EXT_INTMAP_INITIAL_CAPACITY_;                                               \
+        while(!ext_intmap_fits_(amount, cap)) cap *= 2;                                            \
+        name##_rehash_(map, cap);                                                                  \
+    }                                                                                              \
+                                                                                                   \
+    static inline V* name##_get(const name* map, K key) {                                          \
+        if(key == 0) return map->has_zero ? (V*)&map->zero.value : NULL;                           \
+        if(!map->entries) return NULL;                                                             \
+        name##_entry* e = &map->entries[name##_find_(map, key)];                                   \
+        return e->key != 0 ? &e->value : NULL;                                                     \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_contains(const name* map, K key) {                                   \
+        return name##_get(map, key) != NULL;                                                       \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns a pointer to the value of `key`, inserting a new uninitialized one if not found */ \
+    static inline V* name##_emplace(name* map, K key, bool* inserted) {                            \
+        bool is_new;                                                                               \
+        V* value;                                                                                  \
+        if(key == 0) {                                                                             \
+            is_new = !map->has_zero;                                                               \
+            map->has_zero = true;                                                                  \
+            map->zero.key = 0;                                                                     \
+            value = &map->zero.value;                                                              \
+        } else {                                                                                   \
+            if(!ext_intmap_fits_(map->size + 1, name##_capacity(map))) {                           \
+                name##_reserve(map, map->size + 1);                                                \
+            }                                                                                      \
+            name##_entry* e = &map->entries[name##_find_(map, key)];                               \
+            is_new = e->key == 0;                                                                  \
+            e->key = key;                                                                          \
+            value = &e->value;                                                                     \
+        }                                                                                          \
+        map->size += is_new;                                                                       \
+        if(inserted) *inserted = is_new;                                                           \
+        return value;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_put(name* map, K key, V value) {                                     \
+        bool inserted;                                                                             \
+        *name##_emplace(map, key, &inserted) = value;                                              \
+        return inserted;                                                                           \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_erase(name* map, K key) {                                            \
+        if(key == 0) {                                                                             \
+            if(!map->has_zero) return false;                                                       \
+            map->has_zero = false;                                                                 \
+            map->size--;                                                                           \
+            return true;                                                                           \
+        }                                                                                          \
+        if(!map->entries) return false;                                                            \
+        size_t i = name##_find_(map, key);                                                         \
+        if(map->entries[i].key == 0) return false;                                                 \
+        ext_intmap_erase_slot_(map->entries, map->capacity_mask, i, .key);                         \
+        map->size--;                                                                               \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_clear(name* map) {                                                   \
+        if(map->entries) memset(map->entries, 0, name##_capacity(map) * sizeof(*map->entries));    \
+        map->has_zero = false;                                                                     \
+        map->size = 0;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    /* Iteration visits the entry of key 0 first, if present, and then the table */                \
+    static inline name##_entry* name##_end(const name* map) {                                      \
+        return map->entries ? map->entries + name##_capacity(map) : NULL;                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_next_(const name* map, size_t i) {                          \
+        for(; i < name##_capacity(map); i++) {                                                     \
+            if(map->entries[i].key != 0) return &map->entries[i];                                  \
+        }                                                                                          \
+        return name##_end(map);                                                                    \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_begin(const name* map) {                                    \
+        return map->has_zero ? (name##_entry*)&map->zero : name##_next_(map, 0);                   \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_incr(const name* map, const name##_entry* it) {             \
+        if(it == &map->zero) return name##_next_(map, 0);                                          \
+        return name##_next_(map, it - map->entries + 1);                                           \
+    }
+
+#define EXT_INTSET_DECLARE(name, K)                                                                \
+    typedef struct name {                                                                          \
+        size_t capacity_mask, size;                                                                \
+        K* keys; /* A slot is empty if it contains 0 */                                            \
+        bool has_zero;                                                                             \
+        K zero; /* Always 0, pointed to by iterators when `has_zero` */                            \
+    } name;                                                                                        \
+                                                                                                   \
+    static inline void name##_free(name* set) {                                                    \
+        EXT_FREE(set->keys);                                                                       \
+        memset(set, 0, sizeof(*set));                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_size(const name* set) {                                            \
+        return set->size;                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_capacity(const name* set) {                                        \
+        return set->keys ? set->capacity_mask + 1 : 0;                                             \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_empty(const name* set) {                                             \
+        return set->size == 0;                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_find_(const name* set, K key) {                                    \
+        size_t idx = ext_intmap_hash_((uint64_t)key) & set->capacity_mask;                         \
+        while(set->keys[idx] != key && set->keys[idx] != 0) {                                      \
+            idx = (idx + 1) & set->capacity_mask;                                                  \
+        }                                                                                          \
+        return idx;                                                                                \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_rehash_(name* set, size_t new_cap) {                                 \
+        size_t old_cap = name##_capacity(set);                                                     \
+        K* old_keys = set->keys;                                                                   \
+                                                                                                   \
+        set->keys = EXT_MALLOC(new_cap * sizeof(*set->keys));                                      \
+        ASSERT(set->keys, "Out of memory");                                                        \
+        memset(set->keys, 0, new_cap * sizeof(*set->keys));                                        \
+        set->capacity_mask = new_cap - 1;                                                          \
+                                                                                                   \
+        for(size_t i = 0; i < old_cap; i++) {                                                      \
+            if(old_keys[i] != 0) set->keys[name##_find_(set, old_keys[i])] = old_keys[i];          \
+        }                                                                                          \
+                                                                                                   \
+        EXT_FREE(old_keys);                                                                        \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_reserve(name* set, size_t amount) {                                  \
+        size_t cap = name##_capacity(set);                                                         \
+        if(ext_intmap_fits_(amount, cap)) return;                                                  \
+        if(!cap) cap = EXT_INTMAP_INITIAL_CAPACITY_;                                               \
+        while(!ext_intmap_fits_(amount, cap)) cap *= 2;                                            \
+        name##_rehash_(set, cap);                                                                  \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_contains(const name* set, K key) {                                   \
+        if(key == 0) return set->has_zero;                                                         \
+        if(!set->keys) return false;                                                               \
+        return set->keys[name##_find_(set, key)] != 0;                                             \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns true if `key` wasn't already in the set */                                          \
+    static inline bool name##_insert(name* set, K key) {                                           \
+        bool is_new;                                                                               \
+        if(key == 0) {                                                                             \
+            is_new = !set->has_zero;                                                               \
+            set->has_zero = true;                                                                  \
+        } else {                                                                                   \
+            if(!ext_intmap_fits_(set->size + 1, name##_capacity(set))) {                           \
+                name##_reserve(set, set->size + 1);                                                \
+            }                                                                                      \
+            K* slot = &set->keys[name##_find_(set, key)];                                          \
+            is_new = *slot == 0;                                                                   \
+            *slot = key;                                                                           \
+        }                                                                                          \
+        set->size += is_new;                                                                       \
+        return is_new;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_erase(name* set, K key) {                                            \
+        if(key == 0) {                                                                             \
+            if(!set->has_zero) return false;                                                       \
+            set->has_zero = false;                                                                 \
+            set->size--;                                                                           \
+            return true;                                                                           \
+        }                                                                                          \
+        if(!set->keys) return false;                                                               \
+        size_t i = name##_find_(set, key);                                                         \
+        if(set->keys[i] == 0) return false;                                                        \
+        ext_intmap_erase_slot_(set->keys, set->capacity_mask, i, );                                \
+        set->size--;                                                                               \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_clear(name* set) {                                                   \
+        if(set->keys) memset(set->keys, 0, name##_capacity(set) * sizeof(*set->keys));             \
+        set->has_zero = false;                                                                     \
+        set->size = 0;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    /* Iteration visits the key 0 first, if present, and then the table */                         \
+    static inline const K* name##_end(const name* set) {                                           \
+        return set->keys ? set->keys + name##_capacity(set) : NULL;                                \
+    }                                                                                              \
+                                                                                                   \
+    static inline const K* name##_next_(const name* set, size_t i) {                               \
+        for(; i < name##_capacity(set); i++) {                                                     \
+            if(set->keys[i] != 0) return &set->keys[i];                                            \
+        }                                                                                          \
+        return name##_end(set);                                                                    \
+    }                                                                                              \
+                                                                                                   \
+    static inline const K* name##_begin(const name* set) {                                         \
+        return set->has_zero ? &set->zero : name##_next_(set, 0);                                  \
+    }                                                                                              \
+                                                                                                   \
+    static inline const K* name##_incr(const name* set, const K* it) {                             \
+        if(it == &set->zero) return name##_next_(set, 0);                                          \
+        return name##_next_(set, it - set->keys + 1);                                              \
+    }
+
+#endif  // INTMAP_H
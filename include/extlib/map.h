@@ -3,29 +3,123 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "extlib/alloc.h"
+
 typedef uint32_t (*hash_fn)(const void* entry);
 typedef bool (*compare_fn)(const void* entry1, const void* entry2);
 
 typedef struct ext_map ext_map;
 
 ext_map* ext_map_new(size_t entry_sz, hash_fn hash, compare_fn compare);
+// Same as ext_map_new, but the map will use `allocator` for all its allocations
+ext_map* ext_map_new_with_allocator(size_t entry_sz, hash_fn hash, compare_fn compare,
+                                    const ext_allocator* allocator);
 void ext_map_free(ext_map* map);
 
+// When enabled, growing the map doesn't move all entries at once. Instead, the old and new tables
+// coexist and every subsequent put or erase migrates a bounded number of slots, keeping the
+// worst-case cost of a single operation constant. Disabling it completes any pending migration.
+void ext_map_set_incremental_rehash(ext_map* map, bool incremental);
+
 const void* ext_map_get(const ext_map* map, const void* entry);
 bool ext_map_put(ext_map* map, const void* entry);
+// Returns a pointer to the slot of `entry` in the map, inserting a new one if not already present.
+// `inserted` (if not NULL) is set to true when a new slot is inserted. In that case the slot is
+// left uninitialized, and the caller must write in it an entry equal to `entry` before performing
+// any other operation on the map.
+void* ext_map_emplace(ext_map* map, const void* entry, bool* inserted);
 bool ext_map_erase(ext_map* map, const void* entry);
+
+// Versions of get, put and erase that take in a precomputed hash for `entry`, useful to avoid
+// hashing the same key multiple times. `hash` must be equal to the value returned by the map's
+// hash function on `entry`.
+const void* ext_map_get_hashed(const ext_map* map, const void* entry, uint32_t hash);
+bool ext_map_put_hashed(ext_map* map, const void* entry, uint32_t hash);
+bool ext_map_erase_hashed(ext_map* map, const void* entry, uint32_t hash);
+
 void ext_map_clear(ext_map* map);
 
+// Batched versions of get and put, operating on `count` contiguous entries of size `entry_sz`.
+// Lookups are pipelined and prefetched, so they're faster than calling get/put in a loop.
+// ext_map_get_batch stores the result of every lookup in `out`, ext_map_put_batch returns the
+// number of newly inserted entries.
+void ext_map_get_batch(const ext_map* map, const void* entries, size_t count, const void** out);
+size_t ext_map_put_batch(ext_map* map, const void* entries, size_t count);
+
 size_t ext_map_size(const ext_map* map);
 size_t ext_map_capacity(const ext_map* map);
 bool ext_map_empty(const ext_map* map);
 
+// Instrumentation counters, collected only when extlib is built with EXTLIB_STATS defined (the
+// EXTLIB_STATS CMake option). Without it no counter is compiled in, and ext_map_stats only fills
+// in the fields that can be computed from the state of the map (`tombstones`).
+#define EXT_MAP_PROBE_BUCKETS 8
+
+typedef struct ext_map_statistics {
+    size_t lookups;  // Probe sequences walked to find an entry (get, put, emplace and erase)
+    // Lookups that probed `i + 1` groups. The last bucket also counts the longer ones
+    size_t probe_histogram[EXT_MAP_PROBE_BUCKETS];
+    size_t max_probe;           // Longest probe sequence seen, in groups
+    size_t tombstones;          // Tombstones currently in the map
+    size_t tombstones_created;  // Erases that had to leave a tombstone behind
+    size_t grows;               // Times the table was reallocated with a bigger capacity
+    size_t rehashes_in_place;   // Times the table was rehashed at the same size to drop tombstones
+    uint64_t grow_ns;           // Time spent growing and rehashing in place
+} ext_map_statistics;
+
+ext_map_statistics ext_map_stats(const ext_map* map);
+void ext_map_reset_stats(ext_map* map);
+
+// Snapshots. ext_map_save writes the tables of the map to `file` exactly as they are in memory,
+// after a small header recording the entry size, the capacity and `hash_id`. ext_map_open_mapped
+// memory maps such a file, so the map can serve lookups right away: there's no rehashing nor
+// copying, and pages are only loaded when first touched.
+// The opened map is read-only, only lookups and iteration are allowed on it. It must still be
+// released with ext_map_free. As entries are saved byte by byte they shouldn't contain pointers,
+// and files can only be opened on machines with the same byte order and struct layout. Only the
+// header is validated when opening, the tables are trusted to be the ones written by ext_map_save.
+// `hash_id` identifies the hash function, that determines where each entry is placed: always use
+// the same id for a given hash function, and a new one if it changes.
+// ext_map_save returns false on write errors, ext_map_open_mapped returns NULL if the file can't be
+// opened or mapped. Both set errno, to EINVAL in case the file is not a snapshot, or its version,
+// entry size or hash id don't match the arguments.
+#define EXT_MAP_FILE_VERSION 1
+
+bool ext_map_save(const ext_map* map, FILE* file, uint32_t hash_id);
+ext_map* ext_map_open_mapped(const char* path, size_t entry_sz, hash_fn hash, compare_fn compare,
+                             uint32_t hash_id);
+
 const void* ext_map_begin(const ext_map* map);
 const void* ext_map_end(const ext_map* map);
 const void* ext_map_incr(const ext_map* map, const void* it);
 
 uint32_t ext_map_hash_bytes(const void* bytes, size_t size);
 
+// Faster hash functions that process the input a word at a time. Prefer them over
+// ext_map_hash_bytes for keys longer than a few bytes.
+uint32_t ext_map_hash_bytes_fast(const void* bytes, size_t size);
+uint64_t ext_map_hash_bytes_fast64(const void* bytes, size_t size);
+
+// Hash functions for integer keys, using the finalizer of MurmurHash3
+static inline uint32_t ext_map_hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline uint32_t ext_map_hash_u64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
 #endif  // MAP_H
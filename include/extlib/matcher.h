@@ -0,0 +1,39 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "extlib/string.h"
+#include "extlib/vector.h"
+
+// Multi-pattern string matcher, based on the Aho-Corasick algorithm. The matcher is compiled once
+// from a list of patterns, and can then find occurrences of all of them in a single pass over the
+// text, independently of the number of patterns.
+// The automaton is stored as a flat transition table indexed by state and byte class, where bytes
+// that don't appear in any pattern all share the same class, so that it stays compact and cache
+// friendly.
+
+typedef struct ext_matcher ext_matcher;
+
+typedef struct ext_match {
+    size_t pattern;  // Index of the pattern in the list passed to ext_matcher_new
+    size_t offset;   // Offset in the text of the start of the match
+} ext_match;
+
+// Patterns are copied in the matcher, so they can be freed after the call. Empty patterns never
+// match.
+ext_matcher* ext_matcher_new(const ext_strview* patterns, size_t count);
+void ext_matcher_free(ext_matcher* matcher);
+
+// Finds the occurrence of any of the patterns that ends first in `text`, preferring the longest
+// pattern when more than one end at the same position. Returns false if there are none.
+bool ext_matcher_find_any(const ext_matcher* matcher, ext_strview text, ext_match* match);
+
+// Returns all occurrences of the patterns in `text`, overlapping ones included, ordered by their
+// end position. Free the returned vector with ext_vec_free.
+ext_vector(ext_match) ext_matcher_find_all(const ext_matcher* matcher, ext_strview text);
+
+size_t ext_matcher_num_patterns(const ext_matcher* matcher);
+
+#endif  // MATCHER_H
@@ -0,0 +1,272 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+
+// A bounded, lock-free ring buffer for passing data between threads. Like ext_vector, a ring is a
+// plain pointer to its elements, with the head and tail indices stored in a header in front of it.
+// Head and tail live on separate cache lines, so that producers and consumers don't contend for
+// the same one.
+// A ring is created either as single-producer/single-consumer (ext_ring_new), or as
+// multi-producer/multi-consumer (ext_ring_new_mpmc). The former must be used by at most one pushing
+// and one popping thread at a time, and is cheaper as it never needs atomic read-modify-writes.
+// Elements are pushed and popped through pointers, and are copied in and out of the ring:
+//
+//     ext_ring(Task) ring = NULL;
+//     ext_ring_new_mpmc(ring, 1024);
+//
+//     Task t = {...};
+//     if(!ext_ring_push(ring, &t)) { /* full */ }
+//     if(ext_ring_pop(ring, &t)) { /* got one */ }
+//
+//     ext_ring_free(ring);
+//
+// The MPMC variant uses a per-slot sequence counter (as in Dmitry Vyukov's bounded queue), so
+// producers and consumers only synchronize on the slots they actually use.
+
+#define EXT_RING_CACHE_LINE 64
+
+// Utility macro for declaring a ring
+#define ext_ring(T) T*
+
+// -----------------------------------------------------------------------------
+// ALLOCATION
+// -----------------------------------------------------------------------------
+
+// Create a new ring that can hold at least `capacity` elements. The capacity is rounded up to the
+// next power of two.
+#define ext_ring_new(ring, capacity)      ext_ring_new_with_allocator(ring, capacity, false, NULL)
+#define ext_ring_new_mpmc(ring, capacity) ext_ring_new_with_allocator(ring, capacity, true, NULL)
+
+#define ext_ring_new_with_allocator(ring, capacity, mpmc, alloc) \
+    ((ring) = ext_ring_alloc_(capacity, sizeof(*(ring)), mpmc, alloc))
+
+// Release ring resources. The ring must not be in use by any thread.
+#define ext_ring_free(ring)                             \
+    do {                                                \
+        if(ring) ext_ring_free_(ring, sizeof(*(ring))); \
+    } while(0)
+
+// -----------------------------------------------------------------------------
+// CAPACITY
+// -----------------------------------------------------------------------------
+
+#define ext_ring_capacity(ring) ((ring) ? ext_ring_header_(ring)->mask + 1 : (size_t)0)
+// Number of elements in the ring. If other threads are using the ring it's only a snapshot.
+#define ext_ring_size(ring)     ((ring) ? ext_ring_size_(ext_ring_header_(ring)) : (size_t)0)
+#define ext_ring_empty(ring)    (ext_ring_size(ring) == 0)
+
+// -----------------------------------------------------------------------------
+// MODIFIERS
+// -----------------------------------------------------------------------------
+
+// Copies `*elem` at the tail of the ring. Returns false if the ring is full.
+#define ext_ring_push(ring, elem) \
+    (ext_ring_typecheck_(ring, elem), ext_ring_push_n_(ring, elem, 1, sizeof(*(ring))) == 1)
+
+// Removes the element at the head of the ring, copying it in `*out`. Returns false if the ring is
+// empty.
+#define ext_ring_pop(ring, out) \
+    (ext_ring_typecheck_(ring, out), ext_ring_pop_n_(ring, out, 1, sizeof(*(ring))) == 1)
+
+// Batch variants: push up to `n` elements from the array `arr`, or pop up to `n` elements into it.
+// Return the number of elements actually pushed or popped, that are moved with at most two
+// memcpys. SPSC rings publish the whole batch with a single atomic store. MPMC rings claim the
+// batch with a single compare-and-swap, but publish it with a release store per slot.
+#define ext_ring_push_n(ring, arr, n) \
+    (ext_ring_typecheck_(ring, arr), ext_ring_push_n_(ring, arr, n, sizeof(*(ring))))
+#define ext_ring_pop_n(ring, arr, n) \
+    (ext_ring_typecheck_(ring, arr), ext_ring_pop_n_(ring, arr, n, sizeof(*(ring))))
+
+// -----------------------------------------------------------------------------
+// PRIVATE - DON'T USE DIRECTLY
+// -----------------------------------------------------------------------------
+
+typedef struct {
+    // Read-only after creation
+    size_t mask;                     // Capacity - 1
+    const ext_allocator* allocator;  // Allocator used by the ring, NULL for the default one
+    atomic_size_t* seq;              // Per-slot sequence numbers, NULL for SPSC rings
+    char pad0_[EXT_RING_CACHE_LINE - sizeof(size_t) - 2 * sizeof(void*)];
+    // Consumer side
+    atomic_size_t head;
+    size_t tail_cache;  // SPSC consumer's last seen tail, to avoid touching the producer's line
+    char pad1_[EXT_RING_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+    // Producer side
+    atomic_size_t tail;
+    size_t head_cache;  // SPSC producer's last seen head
+    char pad2_[EXT_RING_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+} ring_header_t;
+
+#define ext_ring_header_(ring)       ((ring_header_t*)((char*)(ring) - sizeof(ring_header_t)))
+#define ext_ring_data_(header)       ((char*)(header) + sizeof(ring_header_t))
+#define ext_ring_typecheck_(ring, p) ((void)sizeof(*(ring) = *(p)))
+
+// Offset of the sequence numbers from the start of the allocation
+static inline size_t ext_ring_seq_offset_(size_t capacity, size_t elem_size) {
+    size_t size = sizeof(ring_header_t) + capacity * elem_size;
+    return (size + sizeof(atomic_size_t) - 1) & ~(sizeof(atomic_size_t) - 1);
+}
+
+static inline size_t ext_ring_alloc_size_(size_t capacity, size_t elem_size, bool mpmc) {
+    if(!mpmc) return sizeof(ring_header_t) + capacity * elem_size;
+    return ext_ring_seq_offset_(capacity, elem_size) + capacity * sizeof(atomic_size_t);
+}
+
+static inline void* ext_ring_alloc_(size_t capacity, size_t elem_size, bool mpmc,
+                                    const ext_allocator* allocator) {
+    size_t cap = 1;
+    while(cap < capacity) cap <<= 1;
+
+    char* mem = ext_alloc(allocator, ext_ring_alloc_size_(cap, elem_size, mpmc));
+    ASSERT(mem, "Out of memory");
+    ring_header_t* h = (ring_header_t*)mem;
+    h->mask = cap - 1;
+    h->allocator = allocator;
+    h->seq = NULL;
+    atomic_init(&h->head, 0);
+    atomic_init(&h->tail, 0);
+    h->tail_cache = 0;
+    h->head_cache = 0;
+
+    if(mpmc) {
+        h->seq = (atomic_size_t*)(mem + ext_ring_seq_offset_(cap, elem_size));
+        for(size_t i = 0; i < cap; i++) atomic_init(&h->seq[i], i);
+    }
+
+    return ext_ring_data_(h);
+}
+
+static inline void ext_ring_free_(void* ring, size_t elem_size) {
+    ring_header_t* h = ext_ring_header_(ring);
+    ext_free(h->allocator, h, ext_ring_alloc_size_(h->mask + 1, elem_size, h->seq != NULL));
+}
+
+static inline size_t ext_ring_size_(ring_header_t* h) {
+    size_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&h->tail, memory_order_acquire);
+    size_t size = tail - head;
+    // Under concurrent use head can be loaded before it passes tail
+    return size > h->mask + 1 ? 0 : size;
+}
+
+// Copies `n` elements between the ring slots starting at index `pos` and `arr`, wrapping around
+static inline void ext_ring_copy_(ring_header_t* h, size_t pos, void* arr, size_t n,
+                                  size_t elem_size, bool to_ring) {
+    char* data = ext_ring_data_(h);
+    size_t start = pos & h->mask;
+    size_t first = h->mask + 1 - start;
+    if(first > n) first = n;
+    char* slot = data + start * elem_size;
+    char* a = arr;
+    if(to_ring) {
+        memcpy(slot, a, first * elem_size);
+        memcpy(data, a + first * elem_size, (n - first) * elem_size);
+    } else {
+        memcpy(a, slot, first * elem_size);
+        memcpy(a + first * elem_size, data, (n - first) * elem_size);
+    }
+}
+
+static inline size_t ext_ring_spsc_push_n_(ring_header_t* h, const void* arr, size_t n,
+                                           size_t elem_size) {
+    size_t cap = h->mask + 1;
+    size_t tail = atomic_load_explicit(&h->tail, memory_order_relaxed);
+    if(cap - (tail - h->head_cache) < n) {
+        h->head_cache = atomic_load_explicit(&h->head, memory_order_acquire);
+    }
+    size_t space = cap - (tail - h->head_cache);
+    if(n > space) n = space;
+    if(n) {
+        ext_ring_copy_(h, tail, (void*)arr, n, elem_size, true);
+        atomic_store_explicit(&h->tail, tail + n, memory_order_release);
+    }
+    return n;
+}
+
+static inline size_t ext_ring_spsc_pop_n_(ring_header_t* h, void* arr, size_t n,
+                                          size_t elem_size) {
+    size_t head = atomic_load_explicit(&h->head, memory_order_relaxed);
+    if(h->tail_cache - head < n) {
+        h->tail_cache = atomic_load_explicit(&h->tail, memory_order_acquire);
+    }
+    size_t avail = h->tail_cache - head;
+    if(n > avail) n = avail;
+    if(n) {
+        ext_ring_copy_(h, head, arr, n, elem_size, false);
+        atomic_store_explicit(&h->head, head + n, memory_order_release);
+    }
+    return n;
+}
+
+// Claims up to `n` consecutive slots by advancing `counter` with a CAS. A slot at position `pos`
+// is ready when its sequence number is `pos + ready`: 0 for producers (the slot is free), 1 for
+// consumers (the slot is full). Returns the number of claimed slots, starting at `*pos`.
+static inline size_t ext_ring_mpmc_claim_(ring_header_t* h, atomic_size_t* counter, size_t n,
+                                          size_t ready, size_t* pos) {
+    size_t p = atomic_load_explicit(counter, memory_order_relaxed);
+    for(;;) {
+        size_t k = 0;
+        for(; k < n; k++) {
+            size_t seq = atomic_load_explicit(&h->seq[(p + k) & h->mask], memory_order_acquire);
+            if(seq == p + k + ready) continue;
+            // The first slot is a full round behind: the ring is full (or empty for consumers)
+            if(k == 0 && (intptr_t)(seq - (p + ready)) < 0) return 0;
+            break;
+        }
+        if(k == 0) {
+            // Another thread claimed the slot meanwhile, retry
+            p = atomic_load_explicit(counter, memory_order_relaxed);
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(counter, &p, p + k, memory_order_relaxed,
+                                                 memory_order_relaxed)) {
+            *pos = p;
+            return k;
+        }
+    }
+}
+
+static inline size_t ext_ring_mpmc_push_n_(ring_header_t* h, const void* arr, size_t n,
+                                           size_t elem_size) {
+    size_t pos;
+    if(!n || !(n = ext_ring_mpmc_claim_(h, &h->tail, n, 0, &pos))) return 0;
+    ext_ring_copy_(h, pos, (void*)arr, n, elem_size, true);
+    for(size_t i = 0; i < n; i++) {
+        atomic_store_explicit(&h->seq[(pos + i) & h->mask], pos + i + 1, memory_order_release);
+    }
+    return n;
+}
+
+static inline size_t ext_ring_mpmc_pop_n_(ring_header_t* h, void* arr, size_t n,
+                                          size_t elem_size) {
+    size_t pos;
+    if(!n || !(n = ext_ring_mpmc_claim_(h, &h->head, n, 1, &pos))) return 0;
+    ext_ring_copy_(h, pos, arr, n, elem_size, false);
+    for(size_t i = 0; i < n; i++) {
+        atomic_store_explicit(&h->seq[(pos + i) & h->mask], pos + i + h->mask + 1,
+                              memory_order_release);
+    }
+    return n;
+}
+
+static inline size_t ext_ring_push_n_(void* ring, const void* arr, size_t n, size_t elem_size) {
+    ring_header_t* h = ext_ring_header_(ring);
+    if(h->seq) return ext_ring_mpmc_push_n_(h, arr, n, elem_size);
+    return ext_ring_spsc_push_n_(h, arr, n, elem_size);
+}
+
+static inline size_t ext_ring_pop_n_(void* ring, void* arr, size_t n, size_t elem_size) {
+    ring_header_t* h = ext_ring_header_(ring);
+    if(h->seq) return ext_ring_mpmc_pop_n_(h, arr, n, elem_size);
+    return ext_ring_spsc_pop_n_(h, arr, n, elem_size);
+}
+
+#endif  // RING_H
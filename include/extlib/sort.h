@@ -0,0 +1,194 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "extlib/vector.h"
+
+// Type-specialized sorting and searching. As with typed maps, macros are used as poor man's
+// templates: EXT_SORT_DECLARE(name, T, less) declares a set of `static inline` functions sorting
+// and searching arrays of type `T`. `less` must be a function or a function-like macro of the form
+// `bool less(T a, T b)`, returning true if `a` should be ordered before `b`. As everything is known
+// at compile time, comparisons and swaps are inlined, unlike with qsort.
+//
+// Example:
+//     #define point_less(a, b) ((a).x < (b).x)
+//     EXT_SORT_DECLARE(points, Point, point_less)
+//
+//     ext_vec_sort(vec, points);
+//     size_t idx = ext_vec_lower_bound(vec, points, (Point){10, 0});
+//
+// The generated functions are:
+//     void name_sort(T* arr, size_t n)                         introsort, not stable
+//     void name_sort_parallel(T* arr, size_t n, int threads)   multi-threaded merge sort
+//     size_t name_lower_bound(const T* arr, size_t n, T key)   index of the first element not
+//                                                              less than `key`, `n` if none
+//     bool name_binary_search(const T* arr, size_t n, T key)
+
+// Utility less-than macro for types that can be compared using `<`
+#define ext_sort_less(a, b) ((a) < (b))
+
+#define ext_vec_sort(vec, name)               name##_sort(vec, ext_vec_size(vec))
+#define ext_vec_sort_parallel(vec, name, thr) name##_sort_parallel(vec, ext_vec_size(vec), thr)
+#define ext_vec_lower_bound(vec, name, key)   name##_lower_bound(vec, ext_vec_size(vec), key)
+#define ext_vec_binary_search(vec, name, key) name##_binary_search(vec, ext_vec_size(vec), key)
+
+#define EXT_SORT_INSERTION_THRESHOLD_ 16
+
+#define EXT_SORT_DECLARE(name, T, less)                                                             \
+    static inline void name##_swap_(T* a, T* b) {                                                  \
+        T tmp = *a;                                                                                \
+        *a = *b;                                                                                   \
+        *b = tmp;                                                                                  \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_insertion_sort_(T* arr, size_t n) {                                  \
+        for(size_t i = 1; i < n; i++) {                                                            \
+            T x = arr[i];                                                                          \
+            size_t j = i;                                                                          \
+            for(; j > 0 && less(x, arr[j - 1]); j--) arr[j] = arr[j - 1];                          \
+            arr[j] = x;                                                                            \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_sift_down_(T* arr, size_t i, size_t n) {                             \
+        for(size_t child; (child = 2 * i + 1) < n; i = child) {                                    \
+            if(child + 1 < n && less(arr[child], arr[child + 1])) child++;                         \
+            if(!less(arr[i], arr[child])) break;                                                   \
+            name##_swap_(&arr[i], &arr[child]);                                                    \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_heap_sort_(T* arr, size_t n) {                                       \
+        for(size_t i = n / 2; i-- > 0;) name##_sift_down_(arr, i, n);                              \
+        for(size_t i = n; i-- > 1;) {                                                              \
+            name##_swap_(&arr[0], &arr[i]);                                                        \
+            name##_sift_down_(arr, 0, i);                                                          \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    /* Quicksort with median of three, that falls back to heapsort after `depth` bad splits */    \
+    static inline void name##_intro_sort_(T* arr, size_t n, int depth) {                           \
+        while(n > EXT_SORT_INSERTION_THRESHOLD_) {                                                 \
+            if(depth-- == 0) {                                                                     \
+                name##_heap_sort_(arr, n);                                                         \
+                return;                                                                            \
+            }                                                                                      \
+                                                                                                   \
+            size_t mid = n / 2;                                                                    \
+            if(less(arr[mid], arr[0])) name##_swap_(&arr[mid], &arr[0]);                           \
+            if(less(arr[n - 1], arr[0])) name##_swap_(&arr[n - 1], &arr[0]);                       \
+            if(less(arr[n - 1], arr[mid])) name##_swap_(&arr[n - 1], &arr[mid]);                   \
+            T pivot = arr[mid];                                                                    \
+                                                                                                   \
+            /* Hoare partition: [0, j] <= pivot <= (j, n) */                                       \
+            size_t i = 0, j = n - 1;                                                               \
+            for(;;) {                                                                              \
+                while(less(arr[i], pivot)) i++;                                                    \
+                while(less(pivot, arr[j])) j--;                                                    \
+                if(i >= j) break;                                                                  \
+                name##_swap_(&arr[i++], &arr[j--]);                                                \
+            }                                                                                      \
+                                                                                                   \
+            /* Recurse on the smaller half, so that the stack depth stays logarithmic */          \
+            size_t left = j + 1;                                                                   \
+            if(left < n - left) {                                                                  \
+                name##_intro_sort_(arr, left, depth);                                              \
+                arr += left;                                                                       \
+                n -= left;                                                                         \
+            } else {                                                                               \
+                name##_intro_sort_(arr + left, n - left, depth);                                   \
+                n = left;                                                                          \
+            }                                                                                      \
+        }                                                                                          \
+        name##_insertion_sort_(arr, n);                                                            \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_sort(T* arr, size_t n) {                                             \
+        int depth = 0;                                                                             \
+        for(size_t i = n; i > 1; i >>= 1) depth += 2;                                              \
+        name##_intro_sort_(arr, n, depth);                                                         \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_lower_bound(const T* arr, size_t n, T key) {                       \
+        size_t lo = 0;                                                                             \
+        while(n > 0) {                                                                             \
+            size_t half = n / 2;                                                                   \
+            if(less(arr[lo + half], key)) {                                                        \
+                lo += half + 1;                                                                    \
+                n -= half + 1;                                                                     \
+            } else {                                                                               \
+                n = half;                                                                          \
+            }                                                                                      \
+        }                                                                                          \
+        return lo;                                                                                 \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_binary_search(const T* arr, size_t n, T key) {                       \
+        size_t i = name##_lower_bound(arr, n, key);                                                \
+        return i < n && !less(key, arr[i]);                                                        \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_sort_erased_(void* base, size_t count) {                             \
+        name##_sort((T*)base, count);                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_merge_erased_(const void* a, size_t count_a, const void* b,          \
+                                            size_t count_b, void* out) {                           \
+        const T* x = a;                                                                            \
+        const T* y = b;                                                                            \
+        T* o = out;                                                                                \
+        size_t i = 0, j = 0;                                                                       \
+        while(i < count_a && j < count_b) {                                                        \
+            /* Take from `a` on ties, so that the merge is stable */                               \
+            if(less(y[j], x[i])) {                                                                 \
+                *o++ = y[j++];                                                                     \
+            } else {                                                                               \
+                *o++ = x[i++];                                                                     \
+            }                                                                                      \
+        }                                                                                          \
+        while(i < count_a) *o++ = x[i++];                                                          \
+        while(j < count_b) *o++ = y[j++];                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_sort_parallel(T* arr, size_t n, int num_threads) {                   \
+        ext_sort_parallel(arr, n, sizeof(T), name##_sort_erased_, name##_merge_erased_,            \
+                          num_threads);                                                            \
+    }
+
+// -----------------------------------------------------------------------------
+// RADIX SORT
+// -----------------------------------------------------------------------------
+
+// LSD radix sorts for arrays of numeric keys, in ascending order. They run in linear time, and
+// skip the passes on bytes that are the same for all keys. Floats are ordered as by `<`, with
+// negative zero before positive zero and NaNs ordered by their bit pattern (before all numbers if
+// their sign bit is set, after all numbers otherwise).
+void ext_radix_sort_u32(uint32_t* keys, size_t count);
+void ext_radix_sort_u64(uint64_t* keys, size_t count);
+void ext_radix_sort_i32(int32_t* keys, size_t count);
+void ext_radix_sort_i64(int64_t* keys, size_t count);
+void ext_radix_sort_f32(float* keys, size_t count);
+void ext_radix_sort_f64(double* keys, size_t count);
+
+// Sorts a vector of numeric keys, where `type` is one of u32, u64, i32, i64, f32, f64
+#define ext_vec_radix_sort(vec, type) ext_radix_sort_##type(vec, ext_vec_size(vec))
+
+// -----------------------------------------------------------------------------
+// PARALLEL SORT
+// -----------------------------------------------------------------------------
+
+typedef void (*ext_sort_fn)(void* base, size_t count);
+// Merges the sorted arrays `a` and `b` into `out`, that doesn't overlap with them
+typedef void (*ext_merge_fn)(const void* a, size_t count_a, const void* b, size_t count_b,
+                             void* out);
+
+// Splits the array in `num_threads` runs that are sorted concurrently using `sort`, and then
+// merged in parallel using `merge`. If `num_threads` is 0, the number of online CPUs is used.
+// Usually called through the `name_sort_parallel` functions declared by EXT_SORT_DECLARE.
+void ext_sort_parallel(void* base, size_t count, size_t size, ext_sort_fn sort, ext_merge_fn merge,
+                       int num_threads);
+
+#endif  // SORT_H
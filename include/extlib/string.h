@@ -2,8 +2,12 @@
 #define STRING_H
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "extlib/alloc.h"
 #include "extlib/vector.h"
 
 #define ext_str_npos ((size_t)-1)
@@ -12,6 +16,10 @@ typedef char* ext_string;
 
 ext_string ext_str_new_cap(size_t capacity);
 ext_string ext_str_new_len(const void* data, size_t len);
+// Same as above, but the created string will use `allocator` for all its allocations
+ext_string ext_str_new_cap_with_allocator(size_t capacity, const ext_allocator* allocator);
+ext_string ext_str_new_len_with_allocator(const void* data, size_t len,
+                                          const ext_allocator* allocator);
 ext_string ext_str_dup(const ext_string str);
 ext_string ext_str_new(const char* cstring);
 ext_string ext_str_vfmt(const char* fmt, va_list ap);
@@ -27,6 +35,12 @@ void ext_str_append_str(ext_string* str, const ext_string other);
 void ext_str_append(ext_string* str, const char* cstring);
 void ext_str_append_vfmt(ext_string* str, const char* fmt, va_list ap);
 void ext_str_append_fmt(ext_string* str, const char* fmt, ...);
+// Fast paths to append numbers without going through printf. Hex numbers are in lowercase and
+// without prefix. Doubles use the shortest representation that reads back to the same value.
+void ext_str_append_int(ext_string* str, int64_t n);
+void ext_str_append_uint(ext_string* str, uint64_t n);
+void ext_str_append_hex(ext_string* str, uint64_t n);
+void ext_str_append_double(ext_string* str, double d);
 
 size_t ext_str_find_len(const ext_string str, size_t start_pos, const void* needle, size_t len);
 size_t ext_str_find_str(const ext_string str, size_t start_pos, const ext_string needle);
@@ -41,6 +55,9 @@ size_t ext_str_rfind_char(const ext_string str, size_t start_pos, int c);
 
 void ext_str_to_lower(ext_string str);
 void ext_str_to_upper(ext_string str);
+// Locale-independent versions of the above, that only convert ASCII letters. Much faster.
+void ext_str_to_lower_ascii(ext_string str);
+void ext_str_to_upper_ascii(ext_string str);
 
 ext_vector(ext_string) ext_str_split(const ext_string str, char sep);
 void ext_str_split_free(ext_vector(ext_string) split);
@@ -52,5 +69,157 @@ int ext_str_compare(const ext_string s1, const ext_string s2);
 
 size_t ext_str_size(const ext_string str);
 size_t ext_str_capacity(const ext_string str);
+const ext_allocator* ext_str_allocator(const ext_string str);
+
+// Process-wide instrumentation counters of string reallocations, collected only when extlib is
+// built with EXTLIB_STATS defined (the EXTLIB_STATS CMake option). They are always zero otherwise.
+typedef struct ext_str_statistics {
+    size_t reallocs;        // Buffer reallocations, due to growth, reserve or shrink_to_fit
+    size_t header_changes;  // Reallocations that changed the header size, copying the string
+    size_t realloc_bytes;   // Sum of the capacities requested by the reallocations
+} ext_str_statistics;
+
+ext_str_statistics ext_str_stats(void);
+void ext_str_reset_stats(void);
+
+// Returns the hash of the string (the same as ext_map_hash_bytes_fast on its contents). The hash is
+// computed on the first call and then cached in the string, until it is modified by any of the
+// ext_str functions. When modifying the string directly (e.g. `str[0] = 'a'`), call
+// ext_str_invalidate_hash afterwards.
+uint32_t ext_str_hash(const ext_string str);
+void ext_str_invalidate_hash(ext_string str);
+
+// Hash and compare functions for ext_maps whose entries start with an ext_string key, e.g.:
+//     typedef struct { ext_string key; int value; } Entry;
+//     ext_map* map = ext_map_new(sizeof(Entry), ext_str_map_hash, ext_str_map_compare);
+uint32_t ext_str_map_hash(const void* entry);
+bool ext_str_map_compare(const void* e1, const void* e2);
+
+// -----------------------------------------------------------------------------
+// STRING VIEWS
+// -----------------------------------------------------------------------------
+
+// A non-owning view over a sequence of characters, that can be part of an ext_string, a c-string
+// or any other buffer. The viewed characters must outlive the view. Note that, unlike ext_string,
+// a view isn't guaranteed to be NUL terminated.
+typedef struct ext_strview {
+    const char* data;
+    size_t size;
+} ext_strview;
+
+ext_strview ext_strview_new(const void* data, size_t size);
+ext_strview ext_strview_from_cstr(const char* cstring);
+ext_strview ext_str_view(const ext_string str);
+ext_strview ext_strview_substr(ext_strview view, size_t start, size_t end);
+// Returns a newly allocated ext_string with the contents of `view`
+ext_string ext_strview_to_str(ext_strview view);
+
+size_t ext_strview_find(ext_strview view, size_t start_pos, ext_strview needle);
+size_t ext_strview_find_char(ext_strview view, size_t start_pos, int c);
+
+int ext_strview_compare(ext_strview v1, ext_strview v2);
+bool ext_strview_eq(ext_strview v1, ext_strview v2);
+// Same as ext_map_hash_bytes_fast on the viewed characters
+uint32_t ext_strview_hash(ext_strview view);
+
+// Same as ext_str_split, but returns views into `str` instead of allocating a string per token.
+// Free the returned vector with ext_vec_free.
+ext_vector(ext_strview) ext_str_split_view(const ext_string str, char sep);
+
+// Lazy tokenizer that splits a view by `sep` without allocating. Produces the same tokens of
+// ext_str_split, empty ones included.
+// Example:
+//     ext_strtok tok = ext_strtok_new(ext_str_view(line), ',');
+//     ext_strview field;
+//     while(ext_strtok_next(&tok, &field)) {
+//         ...
+//     }
+typedef struct ext_strtok {
+    ext_strview view;
+    size_t pos;
+    char sep;
+    bool done;
+} ext_strtok;
+
+ext_strtok ext_strtok_new(ext_strview view, char sep);
+// Stores the next token in `tok` and returns true, or returns false if there are no more tokens
+bool ext_strtok_next(ext_strtok* tokenizer, ext_strview* tok);
+
+// -----------------------------------------------------------------------------
+// STRING BUILDER
+// -----------------------------------------------------------------------------
+
+// A string builder that stores appended data in a list of chunks, so that already appended data is
+// never copied again when more room is needed. The final string is built, with a single allocation
+// of the exact size, by ext_strbuilder_to_str.
+// A zero-initialized builder is a valid, empty builder:
+//     ext_strbuilder sb = {0};
+//     ext_strbuilder_append(&sb, "Hello ");
+//     ext_strbuilder_append_fmt(&sb, "%s!", "world");
+//     ext_string str = ext_strbuilder_to_str(&sb);
+//     ext_strbuilder_free(&sb);
+typedef struct ext_strbuilder_chunk ext_strbuilder_chunk;
+
+typedef struct ext_strbuilder {
+    ext_strbuilder_chunk *head, *tail;
+    size_t size;
+} ext_strbuilder;
+
+// Frees all chunks, leaving the builder empty and ready to be reused
+void ext_strbuilder_free(ext_strbuilder* sb);
+
+void ext_strbuilder_append_len(ext_strbuilder* sb, const void* data, size_t len);
+void ext_strbuilder_append(ext_strbuilder* sb, const char* cstring);
+void ext_strbuilder_append_str(ext_strbuilder* sb, const ext_string str);
+void ext_strbuilder_append_vfmt(ext_strbuilder* sb, const char* fmt, va_list ap);
+void ext_strbuilder_append_fmt(ext_strbuilder* sb, const char* fmt, ...);
+
+size_t ext_strbuilder_size(const ext_strbuilder* sb);
+// Returns a new ext_string with the contents of the builder
+ext_string ext_strbuilder_to_str(const ext_strbuilder* sb);
+
+// -----------------------------------------------------------------------------
+// FILES
+// -----------------------------------------------------------------------------
+
+// Read-only view over the whole contents of a file. When supported, the file is memory mapped, so
+// no copy is made and pages are only loaded when accessed. Otherwise (or if mapping fails, for
+// example on pipes), the file is read in memory.
+// Note that the contents of a mapped file aren't NUL terminated.
+typedef struct ext_file_view {
+    ext_strview view;
+    bool mapped;
+} ext_file_view;
+
+// Returns false if the file couldn't be opened or read, with errno set accordingly
+bool ext_file_view_open(const char* path, ext_file_view* file);
+void ext_file_view_close(ext_file_view* file);
+
+// Streaming reader that splits a file into records terminated by `delim` (usually '\n'), reusing
+// the same buffers for all of them, so that files of any size can be processed in constant memory.
+// Example:
+//     ext_linereader reader;
+//     ext_linereader_init(&reader, file, '\n');
+//     ext_string line;
+//     while((line = ext_linereader_next(&reader))) {
+//         ...
+//     }
+//     ext_linereader_free(&reader);
+typedef struct ext_linereader {
+    FILE* file;
+    char delim;
+    bool eof;
+    ext_string line;
+    char* buf;
+    size_t buf_pos, buf_len;
+} ext_linereader;
+
+void ext_linereader_init(ext_linereader* reader, FILE* file, char delim);
+// Frees the reader's buffers. The file is not closed.
+void ext_linereader_free(ext_linereader* reader);
+// Returns the next record without its delimiter, or NULL when the end of the file is reached or an
+// error occurs (use ferror on the file to tell them apart). The returned string is owned by the
+// reader and is overwritten by the next call.
+ext_string ext_linereader_next(ext_linereader* reader);
 
 #endif  // STRING_H
@@ -0,0 +1,180 @@
+#ifndef TYPEDMAP_H
+#define TYPEDMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+#include "extlib/map.h"
+
+// Type-specialized hashmaps. Like with ext_vector, macros are used as poor man's templates:
+// EXT_MAP_DECLARE(name, K, V, hash, eq) declares a struct `name` mapping keys of type `K` to values
+// of type `V`, plus a set of `static inline` functions operating on it. `hash` must be a function
+// or a function-like macro of the form `uint32_t hash(K key)`, and `eq` one of the form
+// `bool eq(K k1, K k2)`. As everything is known at compile time, hashing and comparisons can be
+// inlined by the compiler, and there's no runtime multiplication to compute the entry offsets.
+//
+// Example:
+//     EXT_MAP_DECLARE(intmap, uint64_t, int, ext_map_hash_u64, ext_map_eq)
+//
+//     intmap map = {0};  // A zero-initialized map is a valid map, the empty one
+//     intmap_put(&map, 10, 20);
+//     int* val = intmap_get(&map, 10);
+//     intmap_free(&map);
+//
+// The generated map uses linear probing with a 1-byte control array holding a 7-bit fragment of
+// the hash of every entry, and backward-shift deletion, so no tombstones are ever left behind.
+
+// Utility equality macro for keys that can be compared using `==`
+#define ext_map_eq(k1, k2) ((k1) == (k2))
+
+#define EXT_MAP_MAX_LOAD_FACTOR_ 0.75
+#define EXT_MAP_INITIAL_CAPACITY_ 8
+
+#define EXT_MAP_DECLARE(name, K, V, hash, eq)                                                       \
+    typedef struct name##_entry {                                                                  \
+        K key;                                                                                     \
+        V value;                                                                                   \
+    } name##_entry;                                                                                \
+                                                                                                   \
+    typedef struct name {                                                                          \
+        size_t capacity_mask, size;                                                                \
+        uint8_t* ctrl; /* 0 if empty, 0x80 | 7-bit hash fragment otherwise */                      \
+        name##_entry* entries;                                                                     \
+    } name;                                                                                        \
+                                                                                                   \
+    static inline void name##_free(name* map) {                                                    \
+        EXT_FREE(map->ctrl);                                                                       \
+        EXT_FREE(map->entries);                                                                    \
+        *map = (name){0, 0, NULL, NULL};                                                           \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_size(const name* map) {                                            \
+        return map->size;                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline size_t name##_capacity(const name* map) {                                        \
+        return map->entries ? map->capacity_mask + 1 : 0;                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_empty(const name* map) {                                             \
+        return map->size == 0;                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns the index of `key`, or of the empty slot where it should be inserted */            \
+    static inline size_t name##_find_(const name* map, K key, uint32_t h) {                        \
+        uint8_t frag = 0x80 | (h & 0x7f);                                                          \
+        size_t idx = (h >> 7) & map->capacity_mask;                                                \
+        for(;;) {                                                                                  \
+            uint8_t ctrl = map->ctrl[idx];                                                         \
+            if(ctrl == 0) return idx;                                                              \
+            if(ctrl == frag && eq(map->entries[idx].key, key)) return idx;                         \
+            idx = (idx + 1) & map->capacity_mask;                                                  \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_grow_(name* map) {                                                   \
+        size_t old_cap = name##_capacity(map);                                                     \
+        size_t new_cap = old_cap ? old_cap * 2 : EXT_MAP_INITIAL_CAPACITY_;                        \
+        uint8_t* old_ctrl = map->ctrl;                                                             \
+        name##_entry* old_entries = map->entries;                                                  \
+                                                                                                   \
+        map->ctrl = EXT_MALLOC(new_cap * sizeof(*map->ctrl));                                      \
+        map->entries = EXT_MALLOC(new_cap * sizeof(*map->entries));                                \
+        ASSERT(map->ctrl && map->entries, "Out of memory");                                        \
+        memset(map->ctrl, 0, new_cap * sizeof(*map->ctrl));                                        \
+        map->capacity_mask = new_cap - 1;                                                          \
+                                                                                                   \
+        for(size_t i = 0; i < old_cap; i++) {                                                      \
+            if(old_ctrl[i]) {                                                                      \
+                uint32_t h = hash(old_entries[i].key);                                             \
+                size_t idx = (h >> 7) & map->capacity_mask;                                        \
+                while(map->ctrl[idx]) idx = (idx + 1) & map->capacity_mask;                        \
+                map->ctrl[idx] = old_ctrl[i];                                                      \
+                map->entries[idx] = old_entries[i];                                                \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        EXT_FREE(old_ctrl);                                                                        \
+        EXT_FREE(old_entries);                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    static inline V* name##_get(const name* map, K key) {                                          \
+        if(!map->entries) return NULL;                                                             \
+        size_t idx = name##_find_(map, key, hash(key));                                            \
+        return map->ctrl[idx] ? &map->entries[idx].value : NULL;                                   \
+    }                                                                                              \
+                                                                                                   \
+    /* Returns a pointer to the value of `key`, inserting a new uninitialized one if not found */ \
+    static inline V* name##_emplace(name* map, K key, bool* inserted) {                            \
+        if(map->size + 1 > name##_capacity(map) * EXT_MAP_MAX_LOAD_FACTOR_) {                      \
+            name##_grow_(map);                                                                     \
+        }                                                                                          \
+        uint32_t h = hash(key);                                                                    \
+        size_t idx = name##_find_(map, key, h);                                                    \
+        bool is_new = !map->ctrl[idx];                                                             \
+        if(is_new) {                                                                               \
+            map->ctrl[idx] = 0x80 | (h & 0x7f);                                                    \
+            map->entries[idx].key = key;                                                           \
+            map->size++;                                                                           \
+        }                                                                                          \
+        if(inserted) *inserted = is_new;                                                           \
+        return &map->entries[idx].value;                                                           \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_put(name* map, K key, V value) {                                     \
+        bool inserted;                                                                             \
+        *name##_emplace(map, key, &inserted) = value;                                              \
+        return inserted;                                                                           \
+    }                                                                                              \
+                                                                                                   \
+    static inline bool name##_erase(name* map, K key) {                                            \
+        if(!map->entries) return false;                                                            \
+        size_t i = name##_find_(map, key, hash(key));                                              \
+        if(!map->ctrl[i]) return false;                                                            \
+                                                                                                   \
+        /* Backward-shift deletion: move back following entries that can be moved closer to */   \
+        /* their ideal slot, until an empty slot is found */                                       \
+        for(size_t j = (i + 1) & map->capacity_mask; map->ctrl[j];                                 \
+            j = (j + 1) & map->capacity_mask) {                                                    \
+            size_t home = (hash(map->entries[j].key) >> 7) & map->capacity_mask;                   \
+            if(((j - home) & map->capacity_mask) >= ((j - i) & map->capacity_mask)) {             \
+                map->ctrl[i] = map->ctrl[j];                                                       \
+                map->entries[i] = map->entries[j];                                                 \
+                i = j;                                                                             \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        map->ctrl[i] = 0;                                                                          \
+        map->size--;                                                                               \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline void name##_clear(name* map) {                                                   \
+        if(map->entries) memset(map->ctrl, 0, name##_capacity(map) * sizeof(*map->ctrl));          \
+        map->size = 0;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_end(const name* map) {                                      \
+        return map->entries ? map->entries + name##_capacity(map) : NULL;                          \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_next_(const name* map, size_t i) {                          \
+        for(; i < name##_capacity(map); i++) {                                                     \
+            if(map->ctrl[i]) return &map->entries[i];                                              \
+        }                                                                                          \
+        return name##_end(map);                                                                    \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_begin(const name* map) {                                    \
+        return name##_next_(map, 0);                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline name##_entry* name##_incr(const name* map, const name##_entry* it) {             \
+        return name##_next_(map, it - map->entries + 1);                                           \
+    }
+
+#endif  // TYPEDMAP_H
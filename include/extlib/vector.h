@@ -1,9 +1,11 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "extlib/alloc.h"
 #include "extlib/assert.h"
 
 // Utility macro for iterating in a foreach style
@@ -19,11 +21,17 @@
 #define ext_vector(T) T*
 
 // Release vector resources
-#define ext_vec_free(vec)                   \
-    do {                                    \
-        if(vec) free(ext_vec_header_(vec)); \
+#define ext_vec_free(vec)                                                                     \
+    do {                                                                                      \
+        if(vec) {                                                                             \
+            vec_header_t* header = ext_vec_header_(vec);                                      \
+            ext_free(header->allocator, header, ext_vec_alloc_size_(vec, header->capacity)); \
+        }                                                                                     \
     } while(0)
 
+// Returns the allocator used by the vector, NULL if it uses the default one
+#define ext_vec_allocator(vec) ((vec) ? ext_vec_header_(vec)->allocator : NULL)
+
 // -----------------------------------------------------------------------------
 // CAPACITY
 // -----------------------------------------------------------------------------
@@ -61,12 +69,18 @@
         ext_vec_set_size_(vec, size + 1); \
     } while(0)
 
-#define ext_vec_push_back_all(vec, arr, size)           \
-    do {                                                \
-        ext_vec_reserve(vec, ext_vec_size(vec) + size); \
-        for(size_t i = 0; i < size; i++) {              \
-            ext_vec_push_back(vec, arr[i]);             \
-        }                                               \
+#define ext_vec_push_back_all(vec, arr, size) ext_vec_append_n(vec, arr, size)
+
+// Appends the `n` elements of the array `arr` with a single memcpy
+#define ext_vec_append_n(vec, arr, n)                            \
+    do {                                                         \
+        size_t __n = (n);                                        \
+        if(__n) {                                                \
+            ext_vec_maybe_grow_(vec, __n);                       \
+            size_t __size = ext_vec_size(vec);                   \
+            memcpy((vec) + __size, (arr), __n * sizeof(*(vec))); \
+            ext_vec_set_size_(vec, __size + __n);                \
+        }                                                        \
     } while(0)
 
 #define ext_vec_pop_back(vec)                                              \
@@ -95,28 +109,93 @@
         ext_vec_set_size_(vec, size - 1);               \
     } while(0);
 
+// Inserts the `n` elements of the array `arr` at position `i`. `arr` must not point into `vec`.
+#define ext_vec_insert_range(vec, i, arr, n)                                                \
+    do {                                                                                    \
+        size_t __idx = (i), __n = (n);                                                      \
+        ASSERT(__idx <= ext_vec_size(vec), "Buffer overflow");                              \
+        if(__n) {                                                                           \
+            ext_vec_maybe_grow_(vec, __n);                                                  \
+            size_t __size = ext_vec_size(vec);                                              \
+            memmove((vec) + __idx + __n, (vec) + __idx, (__size - __idx) * sizeof(*(vec))); \
+            memcpy((vec) + __idx, (arr), __n * sizeof(*(vec)));                             \
+            ext_vec_set_size_(vec, __size + __n);                                           \
+        }                                                                                   \
+    } while(0)
+
+// Erases the elements in the range [start, end) with a single memmove
+#define ext_vec_erase_range(vec, start, end)                                            \
+    do {                                                                                \
+        size_t __start = (start), __end = (end);                                        \
+        size_t __size = ext_vec_size(vec);                                              \
+        ASSERT(__start <= __end, "start must be less than or equal to end");            \
+        ASSERT(__end <= __size, "Buffer overflow");                                     \
+        if(__start != __end) {                                                          \
+            memmove((vec) + __start, (vec) + __end, (__size - __end) * sizeof(*(vec))); \
+            ext_vec_set_size_(vec, __size - (__end - __start));                         \
+        }                                                                               \
+    } while(0)
+
+// Erases the element at position `i` in O(1), by moving the last element in its place. Doesn't
+// preserve the order of the elements.
+#define ext_vec_erase_swap(vec, i)                 \
+    do {                                           \
+        size_t __idx = (i);                        \
+        size_t __size = ext_vec_size(vec);         \
+        ASSERT(__idx < __size, "Buffer overflow"); \
+        (vec)[__idx] = (vec)[__size - 1];          \
+        ext_vec_set_size_(vec, __size - 1);        \
+    } while(0)
+
 #define ext_vec_clear(vec)                      \
     do {                                        \
         if(vec) ext_vec_header_(vec)->size = 0; \
     } while(0)
 
-#define ext_vec_reserve(vec, amount)                                                    \
-    do {                                                                                \
-        if(!(vec)) {                                                                    \
-            vec_header_t* header = malloc(sizeof(*header) + (amount) * sizeof(*(vec))); \
-            ASSERT(header, "Out of memory");                                            \
-            header->capacity = (amount);                                                \
-            header->size = 0;                                                           \
-            (vec) = (void*)(header->data);                                              \
-        } else if(ext_vec_capacity(vec) < (amount)) {                                   \
-            vec_header_t* header = ext_vec_header_(vec);                                \
-            header = realloc(header, sizeof(*header) + (amount) * sizeof(*(vec)));      \
-            ASSERT(header, "Out of memory");                                            \
-            header->capacity = (amount);                                                \
-            (vec) = (void*)(header->data);                                              \
-        }                                                                               \
+#define ext_vec_reserve(vec, amount) ext_vec_reserve_with_allocator(vec, amount, NULL)
+
+// Same as ext_vec_reserve, but if `vec` is NULL the new vector will use `alloc` for all its
+// allocations. The allocator of an already allocated vector cannot be changed.
+#define ext_vec_reserve_with_allocator(vec, amount, alloc)                                   \
+    do {                                                                                     \
+        if(!(vec)) {                                                                         \
+            vec_header_t* header = ext_alloc((alloc), ext_vec_alloc_size_(vec, amount));     \
+            ASSERT(header, "Out of memory");                                                 \
+            header->capacity = (amount);                                                     \
+            header->size = 0;                                                                \
+            header->allocator = (alloc);                                                     \
+            header->growth_factor = 0;                                                       \
+            ext_vec_stats_init_(header);                                                     \
+            (vec) = ext_vec_data_(header);                                                   \
+        } else if(ext_vec_capacity(vec) < (amount)) {                                        \
+            vec_header_t* header = ext_vec_header_(vec);                                     \
+            header = ext_realloc(header->allocator, header,                                  \
+                                 ext_vec_alloc_size_(vec, header->capacity),                 \
+                                 ext_vec_alloc_size_(vec, amount));                          \
+            ASSERT(header, "Out of memory");                                                 \
+            ext_vec_stats_realloc_(header);                                                  \
+            header->capacity = (amount);                                                     \
+            (vec) = ext_vec_data_(header);                                                   \
+        }                                                                                    \
+    } while(0)
+
+// Sets the factor by which the capacity of the vector grows when it runs out of space. The default
+// is 2, smaller factors waste less memory on big vectors at the cost of more frequent reallocations.
+#define ext_vec_set_growth_factor(vec, factor)                        \
+    do {                                                              \
+        ASSERT((factor) > 1, "Growth factor must be greater than 1"); \
+        if(!(vec)) ext_vec_reserve(vec, 1);                           \
+        ext_vec_header_(vec)->growth_factor = (factor);               \
     } while(0)
 
+// Returns the number of times the vector has been reallocated. Only tracked when extlib is built
+// with EXTLIB_STATS defined (the EXTLIB_STATS CMake option), always 0 otherwise.
+#ifdef EXTLIB_STATS
+    #define ext_vec_reallocs(vec) ((vec) ? (size_t)ext_vec_header_(vec)->reallocs : (size_t)0)
+#else
+    #define ext_vec_reallocs(vec) ((size_t)0)
+#endif
+
 #define ext_vec_resize(vec, new_size, elem)           \
     do {                                              \
         size_t size = ext_vec_size(vec);              \
@@ -131,20 +210,23 @@
         }                                             \
     } while(0)
 
-#define ext_vec_shrink_to_fit(vec)                                                         \
-    do {                                                                                   \
-        if(vec) {                                                                          \
-            vec_header_t* header = ext_vec_header_(vec);                                   \
-            if(header->size) {                                                             \
-                header = realloc(header, sizeof(*header) + sizeof(*(vec)) * header->size); \
-                ASSERT(header, "Out of memory");                                           \
-                header->capacity = header->size;                                           \
-                (vec) = (void*)(header->data);                                             \
-            } else {                                                                       \
-                free(header);                                                              \
-                (vec) = NULL;                                                              \
-            }                                                                              \
-        }                                                                                  \
+#define ext_vec_shrink_to_fit(vec)                                                          \
+    do {                                                                                    \
+        if(vec) {                                                                           \
+            vec_header_t* header = ext_vec_header_(vec);                                    \
+            size_t old_size = ext_vec_alloc_size_(vec, header->capacity);                   \
+            if(header->size) {                                                              \
+                header = ext_realloc(header->allocator, header, old_size,                   \
+                                     ext_vec_alloc_size_(vec, header->size));               \
+                ASSERT(header, "Out of memory");                                            \
+                ext_vec_stats_realloc_(header);                                             \
+                header->capacity = header->size;                                            \
+                (vec) = ext_vec_data_(header);                                              \
+            } else {                                                                        \
+                ext_free(header->allocator, header, old_size);                              \
+                (vec) = NULL;                                                               \
+            }                                                                               \
+        }                                                                                   \
     } while(0)
 
 // -----------------------------------------------------------------------------
@@ -152,22 +234,48 @@
 // -----------------------------------------------------------------------------
 
 typedef struct {
-    size_t capacity, size;  // Capacity (allocated memory) and size (slots used in the vector)
-    char data[];            // The actual start of the vector memory
+    size_t capacity, size;            // Capacity (allocated memory) and size (slots used in the vector)
+    const ext_allocator* allocator;  // Allocator used by the vector, NULL for the default one
+    float growth_factor;             // Factor by which the capacity grows, 0 for the default (2x)
+    // Number of reallocations, only counted with EXTLIB_STATS. Always present, so that the layout
+    // of the header doesn't depend on whether a translation unit enables stats
+    uint32_t reallocs;
 } vec_header_t;
 
-#define ext_vec_maybe_grow_(vec, amount)                             \
-    do {                                                             \
-        size_t capacity = ext_vec_capacity(vec);                     \
-        size_t size = ext_vec_size(vec);                             \
-        if(size + (amount) > capacity) {                             \
-            size_t new_capacity = capacity ? capacity * 2 : 1;       \
-            while(size + (amount) > new_capacity) new_capacity *= 2; \
-            ext_vec_reserve(vec, new_capacity);                      \
-        }                                                            \
+// The vector memory starts right after the header, that is padded to keep it aligned to 16 bytes
+#define ext_vec_header_size_ ((sizeof(vec_header_t) + 15) & ~(size_t)15)
+
+#define ext_vec_maybe_grow_(vec, amount)                                     \
+    do {                                                                     \
+        size_t capacity = ext_vec_capacity(vec);                             \
+        size_t size = ext_vec_size(vec);                                     \
+        if(size + (amount) > capacity) {                                     \
+            float factor = (vec) ? ext_vec_header_(vec)->growth_factor : 0;  \
+            size_t new_capacity = ext_vec_grow_capacity_(capacity, factor);  \
+            while(size + (amount) > new_capacity) {                          \
+                new_capacity = ext_vec_grow_capacity_(new_capacity, factor); \
+            }                                                                \
+            ext_vec_reserve(vec, new_capacity);                              \
+        }                                                                    \
     } while(0)
 
-#define ext_vec_header_(vec)            ((vec_header_t*)((char*)(vec) - sizeof(vec_header_t)))
+static inline size_t ext_vec_grow_capacity_(size_t capacity, float factor) {
+    if(!capacity) return 1;
+    if(!factor) return capacity * 2;
+    size_t increment = capacity * (double)(factor - 1);
+    return capacity + (increment ? increment : 1);
+}
+
+#define ext_vec_stats_init_(header) ((header)->reallocs = 0)
+#ifdef EXTLIB_STATS
+    #define ext_vec_stats_realloc_(header) ((header)->reallocs++)
+#else
+    #define ext_vec_stats_realloc_(header) ((void)0)
+#endif
+
+#define ext_vec_header_(vec)            ((vec_header_t*)((char*)(vec) - ext_vec_header_size_))
+#define ext_vec_data_(header)           ((void*)((char*)(header) + ext_vec_header_size_))
+#define ext_vec_alloc_size_(vec, cap)   (ext_vec_header_size_ + (cap) * sizeof(*(vec)))
 #define ext_vec_set_capacity_(vec, cap) (ext_vec_header_(vec)->capacity = cap)
 #define ext_vec_set_size_(vec, sz)      (ext_vec_header_(vec)->size = sz)
 
@@ -0,0 +1,25 @@
+#ifndef VM_H
+#define VM_H
+
+#include "extlib/alloc.h"
+
+// An allocator for huge buffers, that grows them without copying their contents.
+// Allocations smaller than EXT_VM_THRESHOLD go through EXT_MALLOC as usual. Bigger ones are
+// mapped directly from the OS:
+//  - On Linux they are grown with mremap, that moves the pages instead of copying them.
+//  - Elsewhere a large range of address space is reserved up front, and pages are committed on
+//    demand as the allocation grows. Only growing past the reservation requires a copy.
+// In both cases, shrinking an allocation returns the unused pages to the OS, so that the resident
+// memory tracks the actual size of the buffer.
+//
+// Example:
+//     int* vec = NULL;
+//     ext_vec_reserve_with_allocator(vec, 1024, ext_vm_allocator());
+
+#define EXT_VM_THRESHOLD (256 * 1024)
+
+// Returns the virtual memory allocator. It is stateless and can be shared by any number of
+// containers.
+const ext_allocator* ext_vm_allocator(void);
+
+#endif  // VM_H
@@ -0,0 +1,149 @@
+#include "extlib/arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib/assert.h"
+
+#define ALIGN(size) (((size) + (EXT_ARENA_ALIGNMENT - 1)) & ~(size_t)(EXT_ARENA_ALIGNMENT - 1))
+
+// Chunks are kept in a list in the order they are used, `current` being the one allocations are
+// carved from. Chunks past `current` are free, and are reused before allocating new ones.
+typedef struct chunk {
+    struct chunk* next;
+    size_t used, capacity;
+} chunk;
+
+// The memory of a chunk starts right after its header, padded to keep it aligned
+#define CHUNK_HEADER_SIZE ALIGN(sizeof(chunk))
+#define CHUNK_DATA(c)     ((char*)(c) + CHUNK_HEADER_SIZE)
+
+struct ext_arena {
+    ext_allocator allocator;
+    size_t chunk_size;
+    chunk* first;
+    chunk* current;
+};
+
+static void* allocator_alloc(void* ctx, size_t size) {
+    return ext_arena_alloc(ctx, size);
+}
+
+static void* allocator_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    return ext_arena_realloc(ctx, ptr, old_size, new_size);
+}
+
+static void allocator_free(void* ctx, void* ptr, size_t size) {
+    ext_arena* arena = ctx;
+    chunk* c = arena->current;
+    char* p = ptr;
+    // Only the last allocation can be given back
+    if(c && p >= CHUNK_DATA(c) && p + ALIGN(size) == CHUNK_DATA(c) + c->used) {
+        c->used -= ALIGN(size);
+    }
+}
+
+static chunk* new_chunk(size_t capacity) {
+    chunk* c = EXT_MALLOC(CHUNK_HEADER_SIZE + capacity);
+    ASSERT(c, "Out of memory");
+    c->next = NULL;
+    c->used = 0;
+    c->capacity = capacity;
+    return c;
+}
+
+// Makes `current` a chunk with at least `size` free bytes, reusing the next free chunk if possible
+static chunk* next_chunk(ext_arena* arena, size_t size) {
+    chunk* c = arena->current;
+    if(c && c->next && c->next->capacity >= size) {
+        c = c->next;
+        c->used = 0;
+    } else {
+        chunk* next = new_chunk(size > arena->chunk_size ? size : arena->chunk_size);
+        if(c) {
+            next->next = c->next;
+            c->next = next;
+        } else {
+            next->next = arena->first;
+            arena->first = next;
+        }
+        c = next;
+    }
+    arena->current = c;
+    return c;
+}
+
+ext_arena* ext_arena_new(size_t chunk_size) {
+    ext_arena* arena = EXT_MALLOC(sizeof(*arena));
+    ASSERT(arena, "Out of memory");
+    arena->allocator = (ext_allocator){allocator_alloc, allocator_realloc, allocator_free, arena};
+    arena->chunk_size = ALIGN(chunk_size ? chunk_size : EXT_ARENA_CHUNK_SIZE);
+    arena->first = NULL;
+    arena->current = NULL;
+    return arena;
+}
+
+void ext_arena_free(ext_arena* arena) {
+    chunk* c = arena->first;
+    while(c) {
+        chunk* next = c->next;
+        EXT_FREE(c);
+        c = next;
+    }
+    EXT_FREE(arena);
+}
+
+void* ext_arena_alloc(ext_arena* arena, size_t size) {
+    size = ALIGN(size ? size : 1);
+    chunk* c = arena->current;
+    if(!c || c->capacity - c->used < size) {
+        c = next_chunk(arena, size);
+    }
+    void* mem = CHUNK_DATA(c) + c->used;
+    c->used += size;
+    return mem;
+}
+
+void* ext_arena_realloc(ext_arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if(!ptr) return ext_arena_alloc(arena, new_size);
+
+    chunk* c = arena->current;
+    char* p = ptr;
+    if(c && p >= CHUNK_DATA(c) && p + ALIGN(old_size) == CHUNK_DATA(c) + c->used) {
+        size_t offset = p - CHUNK_DATA(c);
+        size_t size = ALIGN(new_size ? new_size : 1);
+        if(c->capacity - offset >= size) {
+            c->used = offset + size;
+            return ptr;
+        }
+    } else if(new_size <= old_size) {
+        return ptr;
+    }
+
+    void* mem = ext_arena_alloc(arena, new_size);
+    memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+    return mem;
+}
+
+ext_arena_mark ext_arena_get_mark(const ext_arena* arena) {
+    chunk* c = arena->current;
+    return (ext_arena_mark){c, c ? c->used : 0};
+}
+
+void ext_arena_rewind(ext_arena* arena, ext_arena_mark mark) {
+    if(!mark.chunk) {
+        ext_arena_reset(arena);
+        return;
+    }
+    arena->current = mark.chunk;
+    arena->current->used = mark.used;
+}
+
+void ext_arena_reset(ext_arena* arena) {
+    arena->current = arena->first;
+    if(arena->current) arena->current->used = 0;
+}
+
+const ext_allocator* ext_arena_allocator(ext_arena* arena) {
+    return &arena->allocator;
+}
@@ -0,0 +1,532 @@
+#include "extlib/btree.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib/assert.h"
+
+#define NODE_SIZE    512  // Target size of a node in bytes, a multiple of the cache line
+#define MIN_CAPACITY 4    // Minimum number of entries (or keys) in a node, for huge entries
+
+// -----------------------------------------------------------------------------
+// NODES
+// -----------------------------------------------------------------------------
+
+// Leaves store up to `leaf_cap` entries, inner nodes up to `inner_cap` keys and one child more.
+// Key `i` of an inner node is greater than all entries in child `i`, and less than or equal to all
+// entries in child `i + 1`. Keys are copies of entries, and can outlive the entry they were copied
+// from when it gets erased.
+// Every node has room for one element more than its capacity: elements are always inserted first,
+// and the node is split afterwards if it overflowed.
+typedef struct node {
+    size_t count;       // Entries in a leaf, keys in an inner node
+    struct node* next;  // Next leaf in order, unused by inner nodes
+} node;
+
+// A leaf is followed by its entries, an inner node by its children and then by its keys
+#define NODE_DATA(n) ((char*)(n) + sizeof(node))
+
+struct ext_btree {
+    ext_btree_compare_fn compare;
+    const ext_allocator* allocator;
+    size_t entry_sz;
+    size_t size;
+    size_t leaf_cap, inner_cap;
+    size_t height;  // Number of inner levels, 0 when the root is a leaf
+    node* root;     // NULL when the tree is empty
+    node* first;    // Leftmost leaf, where iteration starts
+    void* sep;      // Scratch space for the separator keys pushed up by splits
+};
+
+static char* leaf_entry(const ext_btree* tree, const node* n, size_t i) {
+    return NODE_DATA(n) + i * tree->entry_sz;
+}
+
+static node** inner_children(const node* n) {
+    return (node**)NODE_DATA(n);
+}
+
+static char* inner_key(const ext_btree* tree, const node* n, size_t i) {
+    return NODE_DATA(n) + (tree->inner_cap + 2) * sizeof(node*) + i * tree->entry_sz;
+}
+
+static size_t leaf_alloc_size(const ext_btree* tree) {
+    return sizeof(node) + (tree->leaf_cap + 1) * tree->entry_sz;
+}
+
+static size_t inner_alloc_size(const ext_btree* tree) {
+    return sizeof(node) + (tree->inner_cap + 2) * sizeof(node*) +
+           (tree->inner_cap + 1) * tree->entry_sz;
+}
+
+static node* new_node(ext_btree* tree, bool leaf) {
+    node* n = ext_alloc(tree->allocator, leaf ? leaf_alloc_size(tree) : inner_alloc_size(tree));
+    ASSERT(n, "Out of memory");
+    n->count = 0;
+    n->next = NULL;
+    return n;
+}
+
+static void free_node(ext_btree* tree, node* n, bool leaf) {
+    ext_free(tree->allocator, n, leaf ? leaf_alloc_size(tree) : inner_alloc_size(tree));
+}
+
+static void free_subtree(ext_btree* tree, node* n, size_t height) {
+    if(height) {
+        for(size_t i = 0; i <= n->count; i++) {
+            free_subtree(tree, inner_children(n)[i], height - 1);
+        }
+    }
+    free_node(tree, n, height == 0);
+}
+
+// Returns the index of the first entry of the leaf not less than `entry`, and sets `found` if it's
+// equal to it
+static size_t leaf_lower_bound(const ext_btree* tree, const node* n, const void* entry,
+                               bool* found) {
+    size_t lo = 0, hi = n->count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = tree->compare(leaf_entry(tree, n, mid), entry);
+        if(cmp == 0) {
+            *found = true;
+            return mid;
+        }
+        if(cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+// Returns the index of the first entry of the leaf greater than `entry`
+static size_t leaf_upper_bound(const ext_btree* tree, const node* n, const void* entry) {
+    size_t lo = 0, hi = n->count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(tree->compare(leaf_entry(tree, n, mid), entry) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Returns the index of the child of an inner node that could contain `entry`
+static size_t inner_child_index(const ext_btree* tree, const node* n, const void* entry) {
+    size_t lo = 0, hi = n->count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(tree->compare(inner_key(tree, n, mid), entry) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const node* find_leaf(const ext_btree* tree, const void* entry) {
+    const node* n = tree->root;
+    for(size_t h = tree->height; h > 0; h--) {
+        n = inner_children(n)[inner_child_index(tree, n, entry)];
+    }
+    return n;
+}
+
+// Moves the elements in [i, count) of an array one position forward (`dir` = 1) or backward (-1)
+static void shift(char* base, size_t elem_sz, size_t i, size_t count, int dir) {
+    if(i >= count) return;
+    memmove(base + (i + dir) * elem_sz, base + i * elem_sz, (count - i) * elem_sz);
+}
+
+// -----------------------------------------------------------------------------
+// INSERTION
+// -----------------------------------------------------------------------------
+
+// Splits an overflowing leaf in two halves. The first entry of the new right leaf is copied in
+// `tree->sep`, to be inserted in the parent.
+static node* split_leaf(ext_btree* tree, node* left) {
+    node* right = new_node(tree, true);
+    size_t keep = (left->count + 1) / 2;
+    right->count = left->count - keep;
+    memcpy(leaf_entry(tree, right, 0), leaf_entry(tree, left, keep), right->count * tree->entry_sz);
+    left->count = keep;
+
+    right->next = left->next;
+    left->next = right;
+    memcpy(tree->sep, leaf_entry(tree, right, 0), tree->entry_sz);
+    return right;
+}
+
+// Splits an overflowing inner node in two. The middle key moves up to the parent through
+// `tree->sep`.
+static node* split_inner(ext_btree* tree, node* left) {
+    node* right = new_node(tree, false);
+    size_t mid = left->count / 2;
+    right->count = left->count - mid - 1;
+    memcpy(inner_key(tree, right, 0), inner_key(tree, left, mid + 1),
+           right->count * tree->entry_sz);
+    memcpy(inner_children(right), inner_children(left) + mid + 1,
+           (right->count + 1) * sizeof(node*));
+    memcpy(tree->sep, inner_key(tree, left, mid), tree->entry_sz);
+    left->count = mid;
+    return right;
+}
+
+// Inserts `entry` in the subtree rooted at `n`. If `n` had to be split, returns the new node
+// holding its upper half, with the key separating the two in `tree->sep`.
+static node* insert(ext_btree* tree, node* n, size_t height, const void* entry, bool* inserted) {
+    if(height == 0) {
+        bool found;
+        size_t i = leaf_lower_bound(tree, n, entry, &found);
+        if(found) {
+            memcpy(leaf_entry(tree, n, i), entry, tree->entry_sz);
+            *inserted = false;
+            return NULL;
+        }
+
+        shift(NODE_DATA(n), tree->entry_sz, i, n->count, 1);
+        memcpy(leaf_entry(tree, n, i), entry, tree->entry_sz);
+        n->count++;
+        *inserted = true;
+        return n->count > tree->leaf_cap ? split_leaf(tree, n) : NULL;
+    }
+
+    size_t i = inner_child_index(tree, n, entry);
+    node* right = insert(tree, inner_children(n)[i], height - 1, entry, inserted);
+    if(!right) return NULL;
+
+    shift(inner_key(tree, n, 0), tree->entry_sz, i, n->count, 1);
+    memcpy(inner_key(tree, n, i), tree->sep, tree->entry_sz);
+    shift((char*)inner_children(n), sizeof(node*), i + 1, n->count + 1, 1);
+    inner_children(n)[i + 1] = right;
+    n->count++;
+    return n->count > tree->inner_cap ? split_inner(tree, n) : NULL;
+}
+
+bool ext_btree_put(ext_btree* tree, const void* entry) {
+    if(!tree->root) {
+        tree->root = tree->first = new_node(tree, true);
+    }
+
+    bool inserted;
+    node* right = insert(tree, tree->root, tree->height, entry, &inserted);
+    if(right) {
+        // The root was split, grow the tree by one level
+        node* root = new_node(tree, false);
+        root->count = 1;
+        inner_children(root)[0] = tree->root;
+        inner_children(root)[1] = right;
+        memcpy(inner_key(tree, root, 0), tree->sep, tree->entry_sz);
+        tree->root = root;
+        tree->height++;
+    }
+
+    tree->size += inserted;
+    return inserted;
+}
+
+// -----------------------------------------------------------------------------
+// DELETION
+// -----------------------------------------------------------------------------
+
+static size_t min_count(const ext_btree* tree, size_t height) {
+    return (height ? tree->inner_cap : tree->leaf_cap) / 2;
+}
+
+// Merges child `i + 1` of `parent` into child `i`, removing the key between them
+static void merge_children(ext_btree* tree, node* parent, size_t i, size_t height) {
+    node** children = inner_children(parent);
+    node* left = children[i];
+    node* right = children[i + 1];
+
+    if(height == 0) {
+        memcpy(leaf_entry(tree, left, left->count), leaf_entry(tree, right, 0),
+               right->count * tree->entry_sz);
+        left->count += right->count;
+        left->next = right->next;
+    } else {
+        memcpy(inner_key(tree, left, left->count), inner_key(tree, parent, i), tree->entry_sz);
+        memcpy(inner_key(tree, left, left->count + 1), inner_key(tree, right, 0),
+               right->count * tree->entry_sz);
+        memcpy(inner_children(left) + left->count + 1, inner_children(right),
+               (right->count + 1) * sizeof(node*));
+        left->count += right->count + 1;
+    }
+    free_node(tree, right, height == 0);
+
+    shift(inner_key(tree, parent, 0), tree->entry_sz, i + 1, parent->count, -1);
+    shift((char*)children, sizeof(node*), i + 2, parent->count + 1, -1);
+    parent->count--;
+}
+
+// Moves the last element of child `i - 1` of `parent` to the front of child `i`
+static void borrow_from_left(ext_btree* tree, node* parent, size_t i, size_t height) {
+    node* left = inner_children(parent)[i - 1];
+    node* child = inner_children(parent)[i];
+
+    if(height == 0) {
+        shift(NODE_DATA(child), tree->entry_sz, 0, child->count, 1);
+        memcpy(leaf_entry(tree, child, 0), leaf_entry(tree, left, left->count - 1),
+               tree->entry_sz);
+        memcpy(inner_key(tree, parent, i - 1), leaf_entry(tree, child, 0), tree->entry_sz);
+    } else {
+        shift(inner_key(tree, child, 0), tree->entry_sz, 0, child->count, 1);
+        shift((char*)inner_children(child), sizeof(node*), 0, child->count + 1, 1);
+        memcpy(inner_key(tree, child, 0), inner_key(tree, parent, i - 1), tree->entry_sz);
+        inner_children(child)[0] = inner_children(left)[left->count];
+        memcpy(inner_key(tree, parent, i - 1), inner_key(tree, left, left->count - 1),
+               tree->entry_sz);
+    }
+
+    left->count--;
+    child->count++;
+}
+
+// Moves the first element of child `i + 1` of `parent` to the back of child `i`
+static void borrow_from_right(ext_btree* tree, node* parent, size_t i, size_t height) {
+    node* child = inner_children(parent)[i];
+    node* right = inner_children(parent)[i + 1];
+
+    if(height == 0) {
+        memcpy(leaf_entry(tree, child, child->count), leaf_entry(tree, right, 0), tree->entry_sz);
+        shift(NODE_DATA(right), tree->entry_sz, 1, right->count, -1);
+        memcpy(inner_key(tree, parent, i), leaf_entry(tree, right, 0), tree->entry_sz);
+    } else {
+        memcpy(inner_key(tree, child, child->count), inner_key(tree, parent, i), tree->entry_sz);
+        inner_children(child)[child->count + 1] = inner_children(right)[0];
+        memcpy(inner_key(tree, parent, i), inner_key(tree, right, 0), tree->entry_sz);
+        shift(inner_key(tree, right, 0), tree->entry_sz, 1, right->count, -1);
+        shift((char*)inner_children(right), sizeof(node*), 1, right->count + 1, -1);
+    }
+
+    right->count--;
+    child->count++;
+}
+
+// Restores the minimum occupancy of child `i` of `parent`, whose children are at `height`
+static void rebalance_child(ext_btree* tree, node* parent, size_t i, size_t height) {
+    size_t min = min_count(tree, height);
+    node** children = inner_children(parent);
+
+    if(i > 0 && children[i - 1]->count > min) {
+        borrow_from_left(tree, parent, i, height);
+    } else if(i < parent->count && children[i + 1]->count > min) {
+        borrow_from_right(tree, parent, i, height);
+    } else if(i > 0) {
+        merge_children(tree, parent, i - 1, height);
+    } else {
+        merge_children(tree, parent, i, height);
+    }
+}
+
+// Erases `entry` from the subtree rooted at `n`. Returns false if it wasn't found.
+static bool erase(ext_btree* tree, node* n, size_t height, const void* entry) {
+    if(height == 0) {
+        bool found;
+        size_t i = leaf_lower_bound(tree, n, entry, &found);
+        if(!found) return false;
+        shift(NODE_DATA(n), tree->entry_sz, i + 1, n->count, -1);
+        n->count--;
+        return true;
+    }
+
+    size_t i = inner_child_index(tree, n, entry);
+    node* child = inner_children(n)[i];
+    if(!erase(tree, child, height - 1, entry)) return false;
+    if(child->count < min_count(tree, height - 1)) {
+        rebalance_child(tree, n, i, height - 1);
+    }
+    return true;
+}
+
+bool ext_btree_erase(ext_btree* tree, const void* entry) {
+    if(!tree->root || !erase(tree, tree->root, tree->height, entry)) return false;
+    tree->size--;
+
+    // Shrink the tree when the root is left with a single child, or with no entries
+    node* root = tree->root;
+    if(tree->height && root->count == 0) {
+        tree->root = inner_children(root)[0];
+        tree->height--;
+        free_node(tree, root, false);
+    } else if(!tree->height && root->count == 0) {
+        free_node(tree, root, true);
+        tree->root = tree->first = NULL;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BULK LOADING
+// -----------------------------------------------------------------------------
+
+// Splits `count` elements among `parts` nodes as evenly as possible. Returns the size of part `i`.
+static size_t part_size(size_t count, size_t parts, size_t i) {
+    return count / parts + (i < count % parts);
+}
+
+void ext_btree_load_sorted(ext_btree* tree, const void* entries, size_t count) {
+    ASSERT(!tree->root, "The tree must be empty");
+#ifndef NDEBUG
+    for(size_t i = 1; i < count; i++) {
+        const char* e = (const char*)entries + i * tree->entry_sz;
+        ASSERT(tree->compare(e - tree->entry_sz, e) < 0, "Entries must be sorted and unique");
+    }
+#endif
+    if(!count) return;
+
+    // Build the leaves, distributing the entries evenly so that all of them are at least half full.
+    // `level` holds the nodes of the level being built, and `mins` their smallest entry.
+    size_t num_leaves = (count + tree->leaf_cap - 1) / tree->leaf_cap;
+    node** level = ext_alloc(tree->allocator, num_leaves * sizeof(node*));
+    const char** mins = ext_alloc(tree->allocator, num_leaves * sizeof(char*));
+    ASSERT(level && mins, "Out of memory");
+
+    const char* src = entries;
+    node* prev = NULL;
+    for(size_t i = 0; i < num_leaves; i++) {
+        node* leaf = new_node(tree, true);
+        leaf->count = part_size(count, num_leaves, i);
+        memcpy(leaf_entry(tree, leaf, 0), src, leaf->count * tree->entry_sz);
+        src += leaf->count * tree->entry_sz;
+
+        if(prev) prev->next = leaf;
+        prev = leaf;
+        level[i] = leaf;
+        mins[i] = leaf_entry(tree, leaf, 0);
+    }
+    tree->first = level[0];
+
+    // Build the inner levels bottom up, the separator of each child being its smallest entry.
+    // Parents are written in place of their children, that are not needed anymore.
+    size_t num_nodes = num_leaves;
+    while(num_nodes > 1) {
+        size_t num_parents = (num_nodes + tree->inner_cap) / (tree->inner_cap + 1);
+        size_t child = 0;
+        for(size_t i = 0; i < num_parents; i++) {
+            node* parent = new_node(tree, false);
+            size_t num_children = part_size(num_nodes, num_parents, i);
+            const char* parent_min = mins[child];
+            parent->count = num_children - 1;
+            for(size_t j = 0; j < num_children; j++, child++) {
+                inner_children(parent)[j] = level[child];
+                if(j) memcpy(inner_key(tree, parent, j - 1), mins[child], tree->entry_sz);
+            }
+            level[i] = parent;
+            mins[i] = parent_min;
+        }
+        num_nodes = num_parents;
+        tree->height++;
+    }
+
+    tree->root = level[0];
+    tree->size = count;
+    ext_free(tree->allocator, level, num_leaves * sizeof(node*));
+    ext_free(tree->allocator, mins, num_leaves * sizeof(char*));
+}
+
+// -----------------------------------------------------------------------------
+// TREE
+// -----------------------------------------------------------------------------
+
+// Capacity of a node with `available` bytes for elements of `elem_sz` bytes, keeping one slot free
+// for the element that makes it overflow
+static size_t capacity_for(size_t available, size_t elem_sz) {
+    size_t slots = available / elem_sz;
+    return slots > MIN_CAPACITY + 1 ? slots - 1 : MIN_CAPACITY;
+}
+
+ext_btree* ext_btree_new_with_allocator(size_t entry_sz, ext_btree_compare_fn compare,
+                                        const ext_allocator* allocator) {
+    ASSERT(entry_sz > 0, "Entries cannot be empty");
+    ext_btree* tree = ext_alloc(allocator, sizeof(*tree));
+    ASSERT(tree, "Out of memory");
+    memset(tree, 0, sizeof(*tree));
+    tree->compare = compare;
+    tree->allocator = allocator;
+    tree->entry_sz = entry_sz;
+
+    // Inner nodes have a key and a child per slot, plus an extra child
+    tree->leaf_cap = capacity_for(NODE_SIZE - sizeof(node), entry_sz);
+    tree->inner_cap = capacity_for(NODE_SIZE - sizeof(node) - sizeof(node*),
+                                   entry_sz + sizeof(node*));
+
+    tree->sep = ext_alloc(allocator, entry_sz);
+    ASSERT(tree->sep, "Out of memory");
+    return tree;
+}
+
+ext_btree* ext_btree_new(size_t entry_sz, ext_btree_compare_fn compare) {
+    return ext_btree_new_with_allocator(entry_sz, compare, NULL);
+}
+
+void ext_btree_clear(ext_btree* tree) {
+    if(tree->root) free_subtree(tree, tree->root, tree->height);
+    tree->root = tree->first = NULL;
+    tree->height = 0;
+    tree->size = 0;
+}
+
+void ext_btree_free(ext_btree* tree) {
+    ext_btree_clear(tree);
+    ext_free(tree->allocator, tree->sep, tree->entry_sz);
+    ext_free(tree->allocator, tree, sizeof(*tree));
+}
+
+const void* ext_btree_get(const ext_btree* tree, const void* entry) {
+    if(!tree->root) return NULL;
+    const node* leaf = find_leaf(tree, entry);
+    bool found;
+    size_t i = leaf_lower_bound(tree, leaf, entry, &found);
+    return found ? leaf_entry(tree, leaf, i) : NULL;
+}
+
+size_t ext_btree_size(const ext_btree* tree) {
+    return tree->size;
+}
+
+bool ext_btree_empty(const ext_btree* tree) {
+    return tree->size == 0;
+}
+
+// -----------------------------------------------------------------------------
+// ITERATORS
+// -----------------------------------------------------------------------------
+
+// Points the iterator at entry `idx` of `leaf`, moving to the next leaf if past its end
+static ext_btree_it make_iterator(const ext_btree* tree, const node* leaf, size_t idx) {
+    if(leaf && idx == leaf->count) {
+        leaf = leaf->next;
+        idx = 0;
+    }
+    ext_btree_it it = {leaf ? leaf_entry(tree, leaf, idx) : NULL, tree, leaf, idx};
+    return it;
+}
+
+ext_btree_it ext_btree_begin(const ext_btree* tree) {
+    return make_iterator(tree, tree->first, 0);
+}
+
+ext_btree_it ext_btree_lower_bound(const ext_btree* tree, const void* entry) {
+    if(!tree->root) return make_iterator(tree, NULL, 0);
+    const node* leaf = find_leaf(tree, entry);
+    bool found;
+    return make_iterator(tree, leaf, leaf_lower_bound(tree, leaf, entry, &found));
+}
+
+ext_btree_it ext_btree_upper_bound(const ext_btree* tree, const void* entry) {
+    if(!tree->root) return make_iterator(tree, NULL, 0);
+    const node* leaf = find_leaf(tree, entry);
+    return make_iterator(tree, leaf, leaf_upper_bound(tree, leaf, entry));
+}
+
+void ext_btree_next(ext_btree_it* it) {
+    ASSERT(it->entry, "Iterator is past the end");
+    *it = make_iterator(it->tree_, it->leaf_, it->idx_ + 1);
+}
@@ -0,0 +1,261 @@
+#include "extlib/cmap.h"
+
+#include <string.h>
+
+#include "extlib/assert.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#define DEFAULT_SHARDS 64
+#define MAX_SHARD_BITS 16
+#define CACHE_LINE     64
+
+// -----------------------------------------------------------------------------
+// READER-WRITER LOCKS
+// -----------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+typedef SRWLOCK rwlock_t;
+
+static void rwlock_init(rwlock_t* lock) {
+    InitializeSRWLock(lock);
+}
+
+static void rwlock_destroy(rwlock_t* lock) {
+    UNUSED(lock);
+}
+
+static void rwlock_read(rwlock_t* lock) {
+    AcquireSRWLockShared(lock);
+}
+
+static void rwlock_read_unlock(rwlock_t* lock) {
+    ReleaseSRWLockShared(lock);
+}
+
+static void rwlock_write(rwlock_t* lock) {
+    AcquireSRWLockExclusive(lock);
+}
+
+static void rwlock_write_unlock(rwlock_t* lock) {
+    ReleaseSRWLockExclusive(lock);
+}
+
+#else
+
+typedef pthread_rwlock_t rwlock_t;
+
+static void rwlock_init(rwlock_t* lock) {
+    int res = pthread_rwlock_init(lock, NULL);
+    ASSERT(res == 0, "Couldn't initialize lock");
+    UNUSED(res);
+}
+
+static void rwlock_destroy(rwlock_t* lock) {
+    pthread_rwlock_destroy(lock);
+}
+
+static void rwlock_read(rwlock_t* lock) {
+    pthread_rwlock_rdlock(lock);
+}
+
+static void rwlock_read_unlock(rwlock_t* lock) {
+    pthread_rwlock_unlock(lock);
+}
+
+static void rwlock_write(rwlock_t* lock) {
+    pthread_rwlock_wrlock(lock);
+}
+
+static void rwlock_write_unlock(rwlock_t* lock) {
+    pthread_rwlock_unlock(lock);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// MAP
+// -----------------------------------------------------------------------------
+
+typedef struct shard {
+    rwlock_t lock;
+    ext_map* map;
+} shard;
+
+// Pad shards to a whole number of cache lines, so that threads working on different shards
+// never write to the same cache line
+typedef union padded_shard {
+    shard shard;
+    char pad[(sizeof(shard) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE];
+} padded_shard;
+
+struct ext_cmap {
+    hash_fn hash;
+    size_t entry_sz;
+    int shard_bits;
+    void* shards_mem;  // Unaligned allocation backing `shards`
+    padded_shard* shards;
+};
+
+static shard* shard_for(const ext_cmap* map, uint32_t hash) {
+    // Use the high bits of the hash, as the low ones are used by ext_map to probe for the entry
+    size_t idx = (size_t)((uint64_t)hash >> (32 - map->shard_bits));
+    return &map->shards[idx].shard;
+}
+
+ext_cmap* ext_cmap_new(size_t entry_sz, hash_fn hash, compare_fn compare, size_t num_shards) {
+    if(num_shards == 0) num_shards = DEFAULT_SHARDS;
+
+    int shard_bits = 0;
+    while(((size_t)1 << shard_bits) < num_shards && shard_bits < MAX_SHARD_BITS) {
+        shard_bits++;
+    }
+    num_shards = (size_t)1 << shard_bits;
+
+    ext_cmap* map = EXT_MALLOC(sizeof(*map));
+    ASSERT(map, "Out of memory");
+
+    map->hash = hash;
+    map->entry_sz = entry_sz;
+    map->shard_bits = shard_bits;
+
+    map->shards_mem = EXT_MALLOC(num_shards * sizeof(padded_shard) + CACHE_LINE - 1);
+    ASSERT(map->shards_mem, "Out of memory");
+    uintptr_t aligned = ((uintptr_t)map->shards_mem + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+    map->shards = (padded_shard*)aligned;
+
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_init(&s->lock);
+        s->map = ext_map_new(entry_sz, hash, compare);
+    }
+
+    return map;
+}
+
+void ext_cmap_free(ext_cmap* map) {
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_destroy(&s->lock);
+        ext_map_free(s->map);
+    }
+    EXT_FREE(map->shards_mem);
+    EXT_FREE(map);
+}
+
+bool ext_cmap_get(const ext_cmap* map, const void* entry, void* out) {
+    uint32_t hash = map->hash(entry);
+    shard* s = shard_for(map, hash);
+
+    rwlock_read(&s->lock);
+    const void* found = ext_map_get_hashed(s->map, entry, hash);
+    if(found && out) memcpy(out, found, map->entry_sz);
+    rwlock_read_unlock(&s->lock);
+
+    return found != NULL;
+}
+
+bool ext_cmap_put(ext_cmap* map, const void* entry) {
+    uint32_t hash = map->hash(entry);
+    shard* s = shard_for(map, hash);
+
+    rwlock_write(&s->lock);
+    bool is_new = ext_map_put_hashed(s->map, entry, hash);
+    rwlock_write_unlock(&s->lock);
+
+    return is_new;
+}
+
+bool ext_cmap_erase(ext_cmap* map, const void* entry) {
+    uint32_t hash = map->hash(entry);
+    shard* s = shard_for(map, hash);
+
+    rwlock_write(&s->lock);
+    bool erased = ext_map_erase_hashed(s->map, entry, hash);
+    rwlock_write_unlock(&s->lock);
+
+    return erased;
+}
+
+void ext_cmap_clear(ext_cmap* map) {
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_write(&s->lock);
+        ext_map_clear(s->map);
+        rwlock_write_unlock(&s->lock);
+    }
+}
+
+void ext_cmap_foreach(const ext_cmap* map, ext_cmap_visit_fn fn, void* ctx) {
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_read(&s->lock);
+        for(const void* it = ext_map_begin(s->map); it != ext_map_end(s->map);
+            it = ext_map_incr(s->map, it)) {
+            fn(it, ctx);
+        }
+        rwlock_read_unlock(&s->lock);
+    }
+}
+
+size_t ext_cmap_size(const ext_cmap* map) {
+    size_t size = 0;
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_read(&s->lock);
+        size += ext_map_size(s->map);
+        rwlock_read_unlock(&s->lock);
+    }
+    return size;
+}
+
+bool ext_cmap_empty(const ext_cmap* map) {
+    return ext_cmap_size(map) == 0;
+}
+
+size_t ext_cmap_num_shards(const ext_cmap* map) {
+    return (size_t)1 << map->shard_bits;
+}
+
+ext_map_statistics ext_cmap_stats(const ext_cmap* map) {
+    ext_map_statistics stats = {0};
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        // Lookups update the counters under the read lock, so the totals are only a snapshot
+        rwlock_read(&s->lock);
+        ext_map_statistics shard_stats = ext_map_stats(s->map);
+        rwlock_read_unlock(&s->lock);
+
+        stats.lookups += shard_stats.lookups;
+        for(size_t j = 0; j < EXT_MAP_PROBE_BUCKETS; j++) {
+            stats.probe_histogram[j] += shard_stats.probe_histogram[j];
+        }
+        if(shard_stats.max_probe > stats.max_probe) stats.max_probe = shard_stats.max_probe;
+        stats.tombstones += shard_stats.tombstones;
+        stats.tombstones_created += shard_stats.tombstones_created;
+        stats.grows += shard_stats.grows;
+        stats.rehashes_in_place += shard_stats.rehashes_in_place;
+        stats.grow_ns += shard_stats.grow_ns;
+    }
+    return stats;
+}
+
+void ext_cmap_reset_stats(ext_cmap* map) {
+    size_t num_shards = ext_cmap_num_shards(map);
+    for(size_t i = 0; i < num_shards; i++) {
+        shard* s = &map->shards[i].shard;
+        rwlock_write(&s->lock);
+        ext_map_reset_stats(s->map);
+        rwlock_write_unlock(&s->lock);
+    }
+}
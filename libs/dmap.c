@@ -0,0 +1,270 @@
+#include "extlib/dmap.h"
+
+#include <string.h>
+
+#include "extlib/assert.h"
+
+#define MAX_LOAD_FACTOR  0.75
+#define INITIAL_CAPACITY 8
+#define MIN_HOLES        8  // Never compact the entries for less than this amount of holes
+
+// Special values of the index table
+#define INDEX_EMPTY ((int64_t)-1)
+#define INDEX_DUMMY ((int64_t)-2)
+
+// A hash value of 0 marks an entry as erased (a hole in the entries array)
+#define HOLE_HASH 0
+#define IS_HOLE(map, i) ((map)->hashes[i] == HOLE_HASH)
+
+// The map is implemented in the same way as CPython's dict: entries and their hashes are kept in
+// dense arrays in insertion order, while the hashtable proper, that uses open addressing, only
+// stores indices into those arrays. The index table uses the smallest integer type able to address
+// all entries, so for big entries it takes a fraction of the memory of a classic hashtable.
+struct ext_dmap {
+    hash_fn hash;
+    compare_fn compare;
+    size_t entry_sz;
+    size_t index_mask;
+    size_t index_width;  // Size in bytes of an element of the index table
+    size_t entries_cap;  // Maximum number of entries before growing
+    size_t num_entries;  // Valid entries + holes
+    size_t size;
+    void* index;
+    uint32_t* hashes;
+    void* entries;
+};
+
+static void* entry_at(void* entries, size_t entry_sz, size_t idx) {
+    return ((char*)entries) + idx * entry_sz;
+}
+
+static uint32_t hash_entry(const ext_dmap* map, const void* entry) {
+    uint32_t hash = map->hash(entry);
+    return hash == HOLE_HASH ? hash + 1 : hash;  // reserve hash value 0
+}
+
+static int64_t index_get(const ext_dmap* map, size_t pos) {
+    switch(map->index_width) {
+    case 1:
+        return ((int8_t*)map->index)[pos];
+    case 2:
+        return ((int16_t*)map->index)[pos];
+    case 4:
+        return ((int32_t*)map->index)[pos];
+    default:
+        return ((int64_t*)map->index)[pos];
+    }
+}
+
+static void index_set(ext_dmap* map, size_t pos, int64_t ix) {
+    switch(map->index_width) {
+    case 1:
+        ((int8_t*)map->index)[pos] = (int8_t)ix;
+        break;
+    case 2:
+        ((int16_t*)map->index)[pos] = (int16_t)ix;
+        break;
+    case 4:
+        ((int32_t*)map->index)[pos] = (int32_t)ix;
+        break;
+    default:
+        ((int64_t*)map->index)[pos] = ix;
+        break;
+    }
+}
+
+static size_t index_width_for(size_t capacity) {
+    if(capacity <= INT8_MAX + 1) return 1;
+    if(capacity <= INT16_MAX + 1) return 2;
+    if(capacity <= (size_t)INT32_MAX + 1) return 4;
+    return 8;
+}
+
+// Returns the position in the index table of `entry`, or of the slot where it should be inserted
+static size_t find_pos(const ext_dmap* map, const void* entry, uint32_t hash) {
+    size_t pos = hash & map->index_mask;
+
+    bool dummy_found = false;
+    size_t dummy_pos = 0;
+
+    for(;;) {
+        int64_t ix = index_get(map, pos);
+        if(ix == INDEX_EMPTY) {
+            return dummy_found ? dummy_pos : pos;
+        } else if(ix == INDEX_DUMMY) {
+            if(!dummy_found) {
+                dummy_found = true;
+                dummy_pos = pos;
+            }
+        } else if(map->hashes[ix] == hash &&
+                  map->compare(entry_at(map->entries, map->entry_sz, ix), entry)) {
+            return pos;
+        }
+        pos = (pos + 1) & map->index_mask;  // Read as: (pos + 1) % (map->index_mask + 1)
+    }
+}
+
+// Moves all valid entries at the start of the arrays, preserving their order
+static void compact_entries(ext_dmap* map) {
+    size_t j = 0;
+    for(size_t i = 0; i < map->num_entries; i++) {
+        if(IS_HOLE(map, i)) continue;
+        if(i != j) {
+            map->hashes[j] = map->hashes[i];
+            memcpy(entry_at(map->entries, map->entry_sz, j),
+                   entry_at(map->entries, map->entry_sz, i), map->entry_sz);
+        }
+        j++;
+    }
+    map->num_entries = j;
+}
+
+// Compacts the entries and rebuilds the index table with `index_cap` slots, using the cached hashes
+static void map_rebuild(ext_dmap* map, size_t index_cap) {
+    compact_entries(map);
+
+    size_t entries_cap = index_cap * MAX_LOAD_FACTOR;
+    if(entries_cap != map->entries_cap) {
+        map->entries = EXT_REALLOC(map->entries, entries_cap * map->entry_sz);
+        map->hashes = EXT_REALLOC(map->hashes, entries_cap * sizeof(*map->hashes));
+        ASSERT(map->entries && map->hashes, "Out of memory");
+        map->entries_cap = entries_cap;
+    }
+
+    size_t width = index_width_for(index_cap);
+    if(index_cap != map->index_mask + 1 || !map->index) {
+        EXT_FREE(map->index);
+        map->index = EXT_MALLOC(index_cap * width);
+        ASSERT(map->index, "Out of memory");
+    }
+    memset(map->index, 0xff, index_cap * width);  // All bits set means INDEX_EMPTY for any width
+    map->index_mask = index_cap - 1;
+    map->index_width = width;
+
+    for(size_t i = 0; i < map->num_entries; i++) {
+        size_t pos = map->hashes[i] & map->index_mask;
+        while(index_get(map, pos) != INDEX_EMPTY) {
+            pos = (pos + 1) & map->index_mask;
+        }
+        index_set(map, pos, i);
+    }
+}
+
+ext_dmap* ext_dmap_new(size_t entry_sz, hash_fn hash, compare_fn compare) {
+    ext_dmap* map = EXT_MALLOC(sizeof(*map));
+    ASSERT(map, "Out of memory");
+    *map = (ext_dmap){hash, compare, entry_sz, 0, 0, 0, 0, 0, NULL, NULL, NULL};
+    return map;
+}
+
+void ext_dmap_free(ext_dmap* map) {
+    EXT_FREE(map->index);
+    EXT_FREE(map->hashes);
+    EXT_FREE(map->entries);
+    EXT_FREE(map);
+}
+
+const void* ext_dmap_get(const ext_dmap* map, const void* entry) {
+    if(!map->index) return NULL;
+
+    size_t pos = find_pos(map, entry, hash_entry(map, entry));
+    int64_t ix = index_get(map, pos);
+    if(ix < 0) {
+        return NULL;
+    }
+
+    return entry_at(map->entries, map->entry_sz, ix);
+}
+
+bool ext_dmap_put(ext_dmap* map, const void* entry) {
+    if(map->num_entries + 1 > map->entries_cap) {
+        // If enough entries were erased, reclaim their space instead of growing
+        size_t index_cap = map->index ? map->index_mask + 1 : INITIAL_CAPACITY;
+        if(map->index && map->size + 1 > map->entries_cap / 2) index_cap *= 2;
+        map_rebuild(map, index_cap);
+    }
+
+    uint32_t hash = hash_entry(map, entry);
+    size_t pos = find_pos(map, entry, hash);
+    int64_t ix = index_get(map, pos);
+
+    if(ix >= 0) {
+        memcpy(entry_at(map->entries, map->entry_sz, ix), entry, map->entry_sz);
+        return false;
+    }
+
+    ix = map->num_entries++;
+    index_set(map, pos, ix);
+    map->hashes[ix] = hash;
+    memcpy(entry_at(map->entries, map->entry_sz, ix), entry, map->entry_sz);
+    map->size++;
+
+    return true;
+}
+
+bool ext_dmap_erase(ext_dmap* map, const void* entry) {
+    if(!map->index) return false;
+
+    size_t pos = find_pos(map, entry, hash_entry(map, entry));
+    int64_t ix = index_get(map, pos);
+    if(ix < 0) {
+        return false;
+    }
+
+    index_set(map, pos, INDEX_DUMMY);
+    map->hashes[ix] = HOLE_HASH;
+    map->size--;
+
+    // Compact the entries when holes outnumber valid entries, so that iteration stays proportional
+    // to the size of the map. Note that every dummy in the index table has a matching hole, so
+    // `num_entries` also bounds the fill ratio of the index table.
+    size_t holes = map->num_entries - map->size;
+    if(holes > MIN_HOLES && holes > map->size) {
+        map_rebuild(map, map->index_mask + 1);
+    }
+
+    return true;
+}
+
+void ext_dmap_clear(ext_dmap* map) {
+    if(map->index) {
+        memset(map->index, 0xff, (map->index_mask + 1) * map->index_width);
+        map->num_entries = 0;
+        map->size = 0;
+    }
+}
+
+size_t ext_dmap_size(const ext_dmap* map) {
+    return map->size;
+}
+
+size_t ext_dmap_capacity(const ext_dmap* map) {
+    return map->entries_cap;
+}
+
+bool ext_dmap_empty(const ext_dmap* map) {
+    return map->size == 0;
+}
+
+static const void* next_valid(const ext_dmap* map, size_t start) {
+    for(size_t i = start; i < map->num_entries; i++) {
+        if(!IS_HOLE(map, i)) {
+            return entry_at(map->entries, map->entry_sz, i);
+        }
+    }
+    return ext_dmap_end(map);
+}
+
+const void* ext_dmap_begin(const ext_dmap* map) {
+    if(!map->entries) return NULL;
+    return next_valid(map, 0);
+}
+
+const void* ext_dmap_end(const ext_dmap* map) {
+    return map->entries ? entry_at(map->entries, map->entry_sz, map->num_entries) : NULL;
+}
+
+const void* ext_dmap_incr(const ext_dmap* map, const void* it) {
+    size_t idx = ((const char*)it - (const char*)map->entries) / map->entry_sz;
+    return next_valid(map, idx + 1);
+}
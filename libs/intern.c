@@ -0,0 +1,131 @@
+#include "extlib/intern.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+#include "extlib/map.h"
+
+#define CHUNK_SIZE (64 * 1024)
+
+// Every string is stored in a chunk with its length in front of it, followed by a NUL terminator
+typedef struct chunk {
+    struct chunk* next;
+    size_t used, capacity;
+    char data[];
+} chunk;
+
+typedef struct intern_entry {
+    const char* str;
+    size_t len;
+    uint32_t hash;
+} intern_entry;
+
+struct ext_intern {
+    ext_map* strings;
+    chunk* chunks;
+};
+
+static uint32_t entry_hash(const void* e) {
+    // Hashes are cached in the entries, so that strings are never hashed again when growing
+    return ((const intern_entry*)e)->hash;
+}
+
+static bool entry_compare(const void* e1, const void* e2) {
+    const intern_entry* i1 = e1;
+    const intern_entry* i2 = e2;
+    return i1->len == i2->len && memcmp(i1->str, i2->str, i1->len) == 0;
+}
+
+static char* pool_alloc(ext_intern* pool, size_t size) {
+    chunk* c = pool->chunks;
+    if(!c || c->capacity - c->used < size) {
+        // Big strings get a chunk of their own, so that the current one isn't wasted
+        size_t capacity = size > CHUNK_SIZE / 4 ? size : CHUNK_SIZE;
+        chunk* new_chunk = EXT_MALLOC(sizeof(*new_chunk) + capacity);
+        ASSERT(new_chunk, "Out of memory");
+        new_chunk->used = 0;
+        new_chunk->capacity = capacity;
+
+        if(c && capacity != CHUNK_SIZE) {
+            new_chunk->next = c->next;
+            c->next = new_chunk;
+        } else {
+            new_chunk->next = c;
+            pool->chunks = new_chunk;
+        }
+        c = new_chunk;
+    }
+
+    char* mem = c->data + c->used;
+    c->used += size;
+    return mem;
+}
+
+static void free_chunks(ext_intern* pool) {
+    chunk* c = pool->chunks;
+    while(c) {
+        chunk* next = c->next;
+        EXT_FREE(c);
+        c = next;
+    }
+    pool->chunks = NULL;
+}
+
+ext_intern* ext_intern_new(void) {
+    ext_intern* pool = EXT_MALLOC(sizeof(*pool));
+    ASSERT(pool, "Out of memory");
+    pool->strings = ext_map_new(sizeof(intern_entry), entry_hash, entry_compare);
+    pool->chunks = NULL;
+    return pool;
+}
+
+void ext_intern_free(ext_intern* pool) {
+    free_chunks(pool);
+    ext_map_free(pool->strings);
+    EXT_FREE(pool);
+}
+
+const char* ext_intern_len(ext_intern* pool, const void* data, size_t len) {
+    intern_entry probe = {data, len, ext_map_hash_bytes_fast(data, len)};
+
+    bool inserted;
+    intern_entry* e = ext_map_emplace(pool->strings, &probe, &inserted);
+    if(inserted) {
+        char* mem = pool_alloc(pool, sizeof(size_t) + len + 1);
+        memcpy(mem, &len, sizeof(size_t));
+        char* str = mem + sizeof(size_t);
+        memcpy(str, data, len);
+        str[len] = '\0';
+
+        *e = (intern_entry){str, len, probe.hash};
+    }
+
+    return e->str;
+}
+
+const char* ext_intern_cstr(ext_intern* pool, const char* cstring) {
+    return ext_intern_len(pool, cstring, strlen(cstring));
+}
+
+const char* ext_intern_lookup(const ext_intern* pool, const void* data, size_t len) {
+    intern_entry probe = {data, len, ext_map_hash_bytes_fast(data, len)};
+    const intern_entry* e = ext_map_get_hashed(pool->strings, &probe, probe.hash);
+    return e ? e->str : NULL;
+}
+
+void ext_intern_clear(ext_intern* pool) {
+    free_chunks(pool);
+    ext_map_clear(pool->strings);
+}
+
+size_t ext_intern_size(const ext_intern* pool) {
+    return ext_map_size(pool->strings);
+}
+
+size_t ext_interned_len(const char* interned) {
+    size_t len;
+    memcpy(&len, interned - sizeof(size_t), sizeof(size_t));
+    return len;
+}
@@ -1,147 +1,586 @@
 #include "extlib/map.h"
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "extlib/assert.h"
+#include "stats.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #define MAP_MMAP_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define MAP_MMAP_POSIX
+#endif
 
 #define MAX_LOAD_FACTOR  0.75
-#define INITIAL_CAPACITY 8
+#define INITIAL_CAPACITY 16  // Must be a multiple of GROUP_WIDTH
+#define REHASH_STEP      64  // Slots migrated per operation when rehashing incrementally
+#define BATCH_SIZE       16  // Number of lookups kept in flight by the batched operations
+#define FILE_ALIGNMENT   64  // Alignment of the tables in a saved map
+
+// -----------------------------------------------------------------------------
+// CONTROL BYTES
+// -----------------------------------------------------------------------------
+
+// Every slot of the map has an associated control byte. A control byte is either one of the two
+// special negative values below, or a 7-bit fragment of the hash of the entry stored in the slot
+// (H2). The remaining bits of the hash (H1) are used to select the group from which to start
+// probing.
+
+typedef int8_t ctrl_t;
+
+#define CTRL_EMPTY   ((ctrl_t)-128)  // 0b10000000
+#define CTRL_DELETED ((ctrl_t)-2)    // 0b11111110
+
+#define IS_EMPTY(ctrl) ((ctrl) == CTRL_EMPTY)
+#define IS_TOMB(ctrl)  ((ctrl) == CTRL_DELETED)
+#define IS_VALID(ctrl) ((ctrl) >= 0)
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((ctrl_t)((hash)&0x7f))
+
+// -----------------------------------------------------------------------------
+// GROUPS
+// -----------------------------------------------------------------------------
+
+// The control bytes are probed `GROUP_WIDTH` at a time. Each `group_match*` function returns a
+// bitmask with a bit set for every slot in the group that satisfies the condition. When SIMD isn't
+// available we fallback to a scalar loop.
+
+#define GROUP_WIDTH 16
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MAP_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define MAP_NEON
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(MAP_SSE2)
+    #define PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+    #define PREFETCH(addr) ((void)(addr))
+#endif
+
+typedef uint64_t bitmask_t;
+
+#ifdef MAP_NEON
+    // NEON has no movemask instruction, so we narrow the comparison result to 4 bits per slot and
+    // keep only the top bit of every nibble
+    #define BITMASK_SHIFT 2
+#else
+    #define BITMASK_SHIFT 0
+#endif
+
+static int count_trailing_zeros(bitmask_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanForward64(&idx, mask);
+    return idx;
+#else
+    int count = 0;
+    while(!(mask & 1)) {
+        mask >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+#define BITMASK_LOWEST(mask) (count_trailing_zeros(mask) >> BITMASK_SHIFT)
+#define BITMASK_NEXT(mask)   ((mask) & ((mask)-1))
+
+#if defined(MAP_SSE2)
+
+static bitmask_t group_match(const ctrl_t* group, ctrl_t h2) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+}
+
+static bitmask_t group_match_empty(const ctrl_t* group) {
+    return group_match(group, CTRL_EMPTY);
+}
+
+static bitmask_t group_match_empty_or_deleted(const ctrl_t* group) {
+    // Special control bytes are the only ones with the sign bit set
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint16_t)_mm_movemask_epi8(ctrl);
+}
+
+#elif defined(MAP_NEON)
+
+static bitmask_t neon_mask(uint8x16_t cmp) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ull;
+}
+
+static bitmask_t group_match(const ctrl_t* group, ctrl_t h2) {
+    int8x16_t ctrl = vld1q_s8(group);
+    return neon_mask(vceqq_s8(ctrl, vdupq_n_s8(h2)));
+}
+
+static bitmask_t group_match_empty(const ctrl_t* group) {
+    return group_match(group, CTRL_EMPTY);
+}
+
+static bitmask_t group_match_empty_or_deleted(const ctrl_t* group) {
+    int8x16_t ctrl = vld1q_s8(group);
+    return neon_mask(vcltzq_s8(ctrl));
+}
+
+#else
+
+static bitmask_t group_match(const ctrl_t* group, ctrl_t h2) {
+    bitmask_t mask = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++) {
+        if(group[i] == h2) mask |= (bitmask_t)1 << i;
+    }
+    return mask;
+}
 
-#define EMPTY_MARK 0
-#define TOMB_MARK  1
+static bitmask_t group_match_empty(const ctrl_t* group) {
+    return group_match(group, CTRL_EMPTY);
+}
 
-#define IS_TOMB(bucket)  ((bucket)->hash == TOMB_MARK)
-#define IS_EMPTY(bucket) ((bucket)->hash == EMPTY_MARK)
-#define IS_VALID(bucket) (!IS_EMPTY(bucket) && !IS_TOMB(bucket))
+static bitmask_t group_match_empty_or_deleted(const ctrl_t* group) {
+    bitmask_t mask = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++) {
+        if(group[i] < 0) mask |= (bitmask_t)1 << i;
+    }
+    return mask;
+}
 
-typedef struct ext_map_bucket {
-    uint32_t hash;
-} ext_map_bucket;
+#endif
+
+// -----------------------------------------------------------------------------
+// MAP
+// -----------------------------------------------------------------------------
 
 struct ext_map {
     hash_fn hash;
     compare_fn compare;
+    const ext_allocator* allocator;
     size_t entry_sz;
     size_t capacity_mask;
-    size_t num_entries;
+    size_t num_entries;  // Valid entries + tombstones
     size_t size;
-    ext_map_bucket* buckets;
+    ctrl_t* ctrl;
     void* entries;
+
+    // Incremental rehashing state. While `old_entries` is not NULL the map is migrating entries
+    // from the old table to the current one, `REHASH_STEP` slots at a time
+    bool incremental;
+    size_t old_capacity_mask;
+    size_t old_size;     // Valid entries still in the old table
+    size_t rehash_idx;   // Next slot of the old table to migrate
+    ctrl_t* old_ctrl;
+    void* old_entries;
+
+    // Memory backing the tables of a map opened with ext_map_open_mapped, NULL otherwise.
+    // Mapped maps are read-only.
+    void* file_data;
+    size_t file_size;
+
+#ifdef EXTLIB_STATS
+    ext_map_statistics stats;
+#endif
 };
 
 static void* entry_at(void* entries, size_t entry_sz, size_t idx) {
     return ((char*)entries) + idx * entry_sz;
 }
 
-static void map_grow(ext_map* map) {
-    size_t new_cap = map->capacity_mask ? (map->capacity_mask + 1) * 2 : INITIAL_CAPACITY;
-    void* new_entries = malloc(map->entry_sz * new_cap);
-    ext_map_bucket* new_buckets = calloc(new_cap, sizeof(*new_buckets));
-    ASSERT(new_entries && new_buckets, "Out of memory");
+static uint32_t hash_entry(const ext_map* map, const void* entry) {
+    return map->hash(entry);
+}
 
-    if(map->capacity_mask > 0) {
-        map->num_entries = 0;
-        for(size_t i = 0; i <= map->capacity_mask; i++) {
-            ext_map_bucket* buck = &map->buckets[i];
-            if(IS_VALID(buck)) {
-                size_t new_idx = buck->hash & (new_cap - 1); // Read as: buck->hash % new_cap
-                new_buckets[new_idx] = *buck;
-                memcpy(entry_at(new_entries, map->entry_sz, new_idx),
-                       entry_at(map->entries, map->entry_sz, i), map->entry_sz);
-                map->num_entries++;
-            }
-        }
-    }
+// Groups are probed using triangular numbers, that are guaranteed to visit every group when the
+// number of groups is a power of two
+static size_t probe_start(size_t capacity_mask, uint32_t hash) {
+    return H1(hash) & (capacity_mask / GROUP_WIDTH);
+}
 
-    free(map->entries);
-    free(map->buckets);
+static size_t probe_next(size_t capacity_mask, size_t group, size_t step) {
+    return (group + step) & (capacity_mask / GROUP_WIDTH);
+}
 
-    map->entries = new_entries;
-    map->buckets = new_buckets;
-    map->capacity_mask = new_cap - 1;
+// Returns the index of the first empty or deleted slot in the probe sequence of `hash`.
+// Used when we know for certain the entry is not already in the map.
+static size_t find_free_index(const ext_map* map, uint32_t hash) {
+    size_t group = probe_start(map->capacity_mask, hash);
+    for(size_t step = 1;; step++) {
+        bitmask_t free = group_match_empty_or_deleted(map->ctrl + group * GROUP_WIDTH);
+        if(free) return group * GROUP_WIDTH + BITMASK_LOWEST(free);
+        group = probe_next(map->capacity_mask, group, step);
+    }
 }
 
-static uint32_t hash_entry(const ext_map* map, const void* entry) {
-    uint32_t hash = map->hash(entry);
-    return hash < 2 ? hash + 2 : hash;  // reserve hash values 0 and 1
+// Records the length of a probe sequence that ended after `groups` groups
+static void record_probe(const ext_map* map, size_t groups) {
+#ifdef EXTLIB_STATS
+    // Lookups are logically const, the counters are the only thing they modify
+    ext_map_statistics* stats = &((ext_map*)map)->stats;
+    STAT_INC(stats->lookups);
+    STAT_INC(stats->probe_histogram[groups < EXT_MAP_PROBE_BUCKETS ? groups - 1
+                                                                   : EXT_MAP_PROBE_BUCKETS - 1]);
+    STAT_MAX(stats->max_probe, groups);
+#else
+    UNUSED(map);
+    UNUSED(groups);
+#endif
 }
 
-static size_t find_index(const ext_map* map, const void* entry, uint32_t hash) {
-    size_t idx = hash & map->capacity_mask;
+static size_t find_index_in(const ext_map* map, const ctrl_t* ctrl_bytes, void* entries,
+                            size_t capacity_mask, const void* entry, uint32_t hash) {
+    size_t group = probe_start(capacity_mask, hash);
+    ctrl_t h2 = H2(hash);
 
     bool tomb_found = false;
     size_t tomb_idx = 0;
 
-    for(;;) {
-        ext_map_bucket* buck = &map->buckets[idx];
-        if(!IS_VALID(buck)) {
-            if(IS_EMPTY(buck)) {
-                return tomb_found ? tomb_idx : idx;
-            } else if(!tomb_found) {
+    for(size_t step = 1;; step++) {
+        const ctrl_t* ctrl = ctrl_bytes + group * GROUP_WIDTH;
+
+        for(bitmask_t m = group_match(ctrl, h2); m; m = BITMASK_NEXT(m)) {
+            size_t idx = group * GROUP_WIDTH + BITMASK_LOWEST(m);
+            if(map->compare(entry_at(entries, map->entry_sz, idx), entry)) {
+                record_probe(map, step);
+                return idx;
+            }
+        }
+
+        if(!tomb_found) {
+            bitmask_t free = group_match_empty_or_deleted(ctrl);
+            if(free) {
                 tomb_found = true;
-                tomb_idx = idx;
+                tomb_idx = group * GROUP_WIDTH + BITMASK_LOWEST(free);
             }
-        } else if(buck->hash == hash &&
-                  map->compare(entry_at(map->entries, map->entry_sz, idx), entry)) {
-            return idx;
         }
-        idx = (idx + 1) & map->capacity_mask;  // Read as: (idx + 1) % (map->capacity_mask + 1)
+
+        // An empty slot terminates the probe sequence. If we found one, we also have a free slot
+        if(group_match_empty(ctrl)) {
+            record_probe(map, step);
+            return tomb_idx;
+        }
+
+        group = probe_next(capacity_mask, group, step);
     }
 }
 
-ext_map* ext_map_new(size_t entry_sz, hash_fn hash, compare_fn compare) {
-    ext_map* map = malloc(sizeof(*map));
+static size_t find_index(const ext_map* map, const void* entry, uint32_t hash) {
+    return find_index_in(map, map->ctrl, map->entries, map->capacity_mask, entry, hash);
+}
+
+// Looks up `entry` in the old table during an incremental rehash. Returns (size_t)-1 if not found
+static size_t find_old_index(const ext_map* map, const void* entry, uint32_t hash) {
+    if(!map->old_entries) return (size_t)-1;
+    size_t idx = find_index_in(map, map->old_ctrl, map->old_entries, map->old_capacity_mask,
+                               entry, hash);
+    return IS_VALID(map->old_ctrl[idx]) ? idx : (size_t)-1;
+}
+
+static void free_table(ext_map* map, void* entries, ctrl_t* ctrl, size_t capacity) {
+    ext_free(map->allocator, entries, capacity * map->entry_sz);
+    ext_free(map->allocator, ctrl, capacity * sizeof(ctrl_t));
+}
+
+static void free_old_table(ext_map* map) {
+    if(map->old_entries) {
+        free_table(map, map->old_entries, map->old_ctrl, map->old_capacity_mask + 1);
+    }
+    map->old_entries = NULL;
+    map->old_ctrl = NULL;
+    map->old_capacity_mask = 0;
+    map->old_size = 0;
+    map->rehash_idx = 0;
+}
+
+// Moves up to `amount` slots from the old table to the current one
+static void map_rehash_step(ext_map* map, size_t amount) {
+    if(!map->old_entries) return;
+
+    size_t end = map->rehash_idx + amount;
+    if(end > map->old_capacity_mask + 1 || end < map->rehash_idx) {
+        end = map->old_capacity_mask + 1;
+    }
+
+    for(size_t i = map->rehash_idx; i < end; i++) {
+        if(IS_VALID(map->old_ctrl[i])) {
+            void* entry = entry_at(map->old_entries, map->entry_sz, i);
+            uint32_t hash = hash_entry(map, entry);
+            size_t new_idx = find_free_index(map, hash);
+            map->ctrl[new_idx] = H2(hash);
+            memcpy(entry_at(map->entries, map->entry_sz, new_idx), entry, map->entry_sz);
+            map->num_entries++;
+            map->old_size--;
+            // Leave a tombstone behind, so that lookups and iteration never see the stale copy,
+            // and probe sequences of the entries yet to migrate are left intact
+            map->old_ctrl[i] = CTRL_DELETED;
+        }
+    }
+
+    map->rehash_idx = end;
+    if(map->rehash_idx > map->old_capacity_mask || map->old_size == 0) {
+        free_old_table(map);
+    }
+}
+
+// Marks the slot at `idx` as free. If the slot's group contains an empty slot, no probe sequence
+// could have ever moved past it (groups only lose their last empty slot and never regain it), so
+// we can mark the slot as empty instead of leaving a tombstone. Returns true if a tombstone was
+// left in the slot.
+static bool erase_slot(ctrl_t* ctrl_bytes, size_t idx) {
+    if(group_match_empty(ctrl_bytes + idx / GROUP_WIDTH * GROUP_WIDTH)) {
+        ctrl_bytes[idx] = CTRL_EMPTY;
+        return false;
+    }
+    ctrl_bytes[idx] = CTRL_DELETED;
+    return true;
+}
+
+// Rehashes the map without changing its capacity, getting rid of all tombstones.
+// It works by first marking all tombstones as empty and all valid entries as deleted, and then by
+// reinserting every deleted entry in its ideal position, swapping it with other deleted entries
+// when needed.
+static void map_rehash_in_place(ext_map* map) {
+    STAT_TIMER_START(start);
+    size_t capacity = ext_map_capacity(map);
+    for(size_t i = 0; i < capacity; i++) {
+        map->ctrl[i] = IS_VALID(map->ctrl[i]) ? CTRL_DELETED : CTRL_EMPTY;
+    }
+
+    void* tmp = ext_alloc(map->allocator, map->entry_sz);
+    ASSERT(tmp, "Out of memory");
+
+    for(size_t i = 0; i < capacity; i++) {
+        if(!IS_TOMB(map->ctrl[i])) continue;
+
+        void* entry = entry_at(map->entries, map->entry_sz, i);
+        uint32_t hash = hash_entry(map, entry);
+        size_t new_idx = find_free_index(map, hash);
+
+        // Already in the first group of its probe sequence with a free slot, leave it there
+        if(new_idx / GROUP_WIDTH == i / GROUP_WIDTH) {
+            map->ctrl[i] = H2(hash);
+            continue;
+        }
+
+        void* dest = entry_at(map->entries, map->entry_sz, new_idx);
+        if(IS_EMPTY(map->ctrl[new_idx])) {
+            memcpy(dest, entry, map->entry_sz);
+            map->ctrl[new_idx] = H2(hash);
+            map->ctrl[i] = CTRL_EMPTY;
+        } else {
+            // The destination holds an entry yet to be processed: swap them and process slot `i`
+            // again, as it now contains the displaced entry
+            memcpy(tmp, dest, map->entry_sz);
+            memcpy(dest, entry, map->entry_sz);
+            memcpy(entry, tmp, map->entry_sz);
+            map->ctrl[new_idx] = H2(hash);
+            i--;
+        }
+    }
+
+    ext_free(map->allocator, tmp, map->entry_sz);
+    map->num_entries = map->size;
+
+    STAT_INC(map->stats.rehashes_in_place);
+    STAT_TIMER_STOP(start, map->stats.grow_ns);
+}
+
+static void map_grow(ext_map* map) {
+    STAT_TIMER_START(start);
+    STAT_INC(map->stats.grows);
+
+    // Never keep more than two tables around: complete any pending rehash before growing again
+    map_rehash_step(map, (size_t)-1);
+
+    size_t old_cap = ext_map_capacity(map);
+    size_t new_cap = old_cap ? old_cap * 2 : INITIAL_CAPACITY;
+
+    map->old_entries = map->entries;
+    map->old_ctrl = map->ctrl;
+    map->old_capacity_mask = map->capacity_mask;
+    map->old_size = map->size;
+    map->rehash_idx = 0;
+
+    map->entries = ext_alloc(map->allocator, map->entry_sz * new_cap);
+    map->ctrl = ext_alloc(map->allocator, new_cap * sizeof(ctrl_t));
+    ASSERT(map->entries && map->ctrl, "Out of memory");
+    memset(map->ctrl, CTRL_EMPTY, new_cap * sizeof(ctrl_t));
+    map->capacity_mask = new_cap - 1;
+    map->num_entries = 0;
+
+    if(map->old_entries && !map->incremental) {
+        map_rehash_step(map, (size_t)-1);
+    }
+
+    STAT_TIMER_STOP(start, map->stats.grow_ns);
+}
+
+ext_map* ext_map_new_with_allocator(size_t entry_sz, hash_fn hash, compare_fn compare,
+                                    const ext_allocator* allocator) {
+    ext_map* map = ext_alloc(allocator, sizeof(*map));
     ASSERT(map, "Out of memory");
-    *map = (ext_map){hash, compare, entry_sz, 0, 0, 0, NULL, NULL};
+    memset(map, 0, sizeof(*map));
+    map->hash = hash;
+    map->compare = compare;
+    map->allocator = allocator;
+    map->entry_sz = entry_sz;
     return map;
 }
 
+ext_map* ext_map_new(size_t entry_sz, hash_fn hash, compare_fn compare) {
+    return ext_map_new_with_allocator(entry_sz, hash, compare, NULL);
+}
+
+static void unmap_file(void* data, size_t size);
+
 void ext_map_free(ext_map* map) {
-    free(map->entries);
-    free(map->buckets);
-    free(map);
+    if(map->file_data) {
+        unmap_file(map->file_data, map->file_size);
+        ext_free(map->allocator, map, sizeof(*map));
+        return;
+    }
+    free_old_table(map);
+    if(map->entries) {
+        free_table(map, map->entries, map->ctrl, ext_map_capacity(map));
+    }
+    ext_free(map->allocator, map, sizeof(*map));
 }
 
-const void* ext_map_get(const ext_map* map, const void* entry) {
-    uint32_t hash = hash_entry(map, entry);
+void ext_map_set_incremental_rehash(ext_map* map, bool incremental) {
+    ASSERT(!map->file_data, "Cannot modify a mapped map");
+    map->incremental = incremental;
+    if(!incremental) map_rehash_step(map, (size_t)-1);
+}
+
+static const void* get_hashed(const ext_map* map, const void* entry, uint32_t hash) {
+    if(!map->entries) return NULL;
+
     size_t idx = find_index(map, entry, hash);
 
-    ext_map_bucket* buck = &map->buckets[idx];
-    if(!IS_VALID(buck)) {
-        return NULL;
+    if(!IS_VALID(map->ctrl[idx])) {
+        size_t old_idx = find_old_index(map, entry, hash);
+        if(old_idx == (size_t)-1) return NULL;
+        return entry_at(map->old_entries, map->entry_sz, old_idx);
     }
 
     return entry_at(map->entries, map->entry_sz, idx);
 }
 
-bool ext_map_put(ext_map* map, const void* entry) {
-    if(map->num_entries + 1 > (map->capacity_mask + 1) * MAX_LOAD_FACTOR) {
-        map_grow(map);
+const void* ext_map_get(const ext_map* map, const void* entry) {
+    if(!map->entries) return NULL;
+    return get_hashed(map, entry, hash_entry(map, entry));
+}
+
+const void* ext_map_get_hashed(const ext_map* map, const void* entry, uint32_t hash) {
+    return get_hashed(map, entry, hash);
+}
+
+// Makes sure there's room for `amount` more entries in the map. If tombstones make up for most of
+// the fill ratio, the map is rehashed at the same capacity instead of growing.
+static void map_make_room(ext_map* map, size_t amount) {
+    ASSERT(!map->file_data, "Cannot modify a mapped map");
+    for(;;) {
+        size_t max_entries = ext_map_capacity(map) * MAX_LOAD_FACTOR;
+        // Entries still in the old table will end up in the current one, account for them too
+        if(map->num_entries + map->old_size + amount <= max_entries) break;
+
+        if(!map->old_entries && map->size + amount <= max_entries / 2) {
+            map_rehash_in_place(map);
+        } else {
+            map_grow(map);
+        }
     }
+}
+
+// Finds the slot for `entry`, reserving a new one if it isn't already in the map.
+// When a new slot is reserved its content is left uninitialized.
+static void* emplace_hashed(ext_map* map, const void* entry, uint32_t hash, bool* inserted) {
+    map_make_room(map, 1);
+    map_rehash_step(map, REHASH_STEP);
 
-    uint32_t hash = hash_entry(map, entry);
     size_t idx = find_index(map, entry, hash);
-    ext_map_bucket* buck = &map->buckets[idx];
+    ctrl_t* ctrl = &map->ctrl[idx];
+    void* slot = entry_at(map->entries, map->entry_sz, idx);
 
-    bool is_new = !IS_VALID(buck);
+    bool is_new = !IS_VALID(*ctrl);
     if(is_new) {
-        map->size++;
-        if(IS_EMPTY(buck)) map->num_entries++;
+        // If the entry is still in the old table, move it over to the current one
+        size_t old_idx = find_old_index(map, entry, hash);
+        if(old_idx != (size_t)-1) {
+            memcpy(slot, entry_at(map->old_entries, map->entry_sz, old_idx), map->entry_sz);
+            erase_slot(map->old_ctrl, old_idx);
+            map->old_size--;
+            is_new = false;
+        } else {
+            map->size++;
+        }
+
+        if(IS_EMPTY(*ctrl)) map->num_entries++;
+        *ctrl = H2(hash);
     }
 
-    buck->hash = hash;
-    memcpy(entry_at(map->entries, map->entry_sz, idx), entry, map->entry_sz);
+    if(inserted) *inserted = is_new;
+    return slot;
+}
 
+static bool put_hashed(ext_map* map, const void* entry, uint32_t hash) {
+    bool is_new;
+    void* slot = emplace_hashed(map, entry, hash, &is_new);
+    memcpy(slot, entry, map->entry_sz);
     return is_new;
 }
 
-bool ext_map_erase(ext_map* map, const void* entry) {
-    uint32_t hash = hash_entry(map, entry);
+bool ext_map_put(ext_map* map, const void* entry) {
+    return put_hashed(map, entry, hash_entry(map, entry));
+}
+
+bool ext_map_put_hashed(ext_map* map, const void* entry, uint32_t hash) {
+    return put_hashed(map, entry, hash);
+}
+
+void* ext_map_emplace(ext_map* map, const void* entry, bool* inserted) {
+    return emplace_hashed(map, entry, hash_entry(map, entry), inserted);
+}
+
+static bool erase_hashed(ext_map* map, const void* entry, uint32_t hash) {
+    if(!map->entries) return false;
+    ASSERT(!map->file_data, "Cannot modify a mapped map");
+    map_rehash_step(map, REHASH_STEP);
+
     size_t idx = find_index(map, entry, hash);
 
-    ext_map_bucket* buck = &map->buckets[idx];
-    if(IS_VALID(buck)) {
-        buck->hash = TOMB_MARK;
+    if(IS_VALID(map->ctrl[idx])) {
+        if(erase_slot(map->ctrl, idx)) {
+            STAT_INC(map->stats.tombstones_created);
+        } else {
+            map->num_entries--;
+        }
+        map->size--;
+        return true;
+    }
+
+    size_t old_idx = find_old_index(map, entry, hash);
+    if(old_idx != (size_t)-1) {
+        erase_slot(map->old_ctrl, old_idx);
+        map->old_size--;
         map->size--;
         return true;
     }
@@ -149,11 +588,79 @@ bool ext_map_erase(ext_map* map, const void* entry) {
     return false;
 }
 
-void ext_map_clear(ext_map* map) {
-    if(map->capacity_mask > 0) {
-        for(size_t i = 0; i <= map->capacity_mask; i++) {
-            map->buckets[i].hash = EMPTY_MARK;
+bool ext_map_erase(ext_map* map, const void* entry) {
+    if(!map->entries) return false;
+    return erase_hashed(map, entry, hash_entry(map, entry));
+}
+
+bool ext_map_erase_hashed(ext_map* map, const void* entry, uint32_t hash) {
+    return erase_hashed(map, entry, hash);
+}
+
+// The batched operations work in chunks of `BATCH_SIZE` entries. First all entries in the chunk
+// are hashed and the control bytes of their first probe group are prefetched, then the candidate
+// entries matching the hash fragment are prefetched, and only then the lookups are resolved. This
+// way the cache misses of different lookups overlap instead of being serialized.
+static void batch_prefetch(const ext_map* map, const void* entries, size_t count,
+                           uint32_t* hashes) {
+    for(size_t i = 0; i < count; i++) {
+        hashes[i] = hash_entry(map, entry_at((void*)entries, map->entry_sz, i));
+        PREFETCH(map->ctrl + probe_start(map->capacity_mask, hashes[i]) * GROUP_WIDTH);
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        size_t group = probe_start(map->capacity_mask, hashes[i]);
+        bitmask_t match = group_match(map->ctrl + group * GROUP_WIDTH, H2(hashes[i]));
+        if(match) {
+            size_t idx = group * GROUP_WIDTH + BITMASK_LOWEST(match);
+            PREFETCH(entry_at(map->entries, map->entry_sz, idx));
+        }
+    }
+}
+
+void ext_map_get_batch(const ext_map* map, const void* entries, size_t count, const void** out) {
+    if(!map->entries) {
+        for(size_t i = 0; i < count; i++) out[i] = NULL;
+        return;
+    }
+
+    uint32_t hashes[BATCH_SIZE];
+    for(size_t base = 0; base < count; base += BATCH_SIZE) {
+        size_t chunk = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
+        const void* chunk_entries = entry_at((void*)entries, map->entry_sz, base);
+
+        batch_prefetch(map, chunk_entries, chunk, hashes);
+        for(size_t i = 0; i < chunk; i++) {
+            const void* entry = entry_at((void*)chunk_entries, map->entry_sz, i);
+            out[base + i] = get_hashed(map, entry, hashes[i]);
+        }
+    }
+}
+
+size_t ext_map_put_batch(ext_map* map, const void* entries, size_t count) {
+    size_t inserted = 0;
+    uint32_t hashes[BATCH_SIZE];
+    for(size_t base = 0; base < count; base += BATCH_SIZE) {
+        size_t chunk = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
+        const void* chunk_entries = entry_at((void*)entries, map->entry_sz, base);
+
+        // Grow beforehand, so that the prefetched cache lines stay valid during the chunk
+        map_make_room(map, chunk);
+
+        batch_prefetch(map, chunk_entries, chunk, hashes);
+        for(size_t i = 0; i < chunk; i++) {
+            const void* entry = entry_at((void*)chunk_entries, map->entry_sz, i);
+            inserted += put_hashed(map, entry, hashes[i]);
         }
+    }
+    return inserted;
+}
+
+void ext_map_clear(ext_map* map) {
+    ASSERT(!map->file_data, "Cannot modify a mapped map");
+    free_old_table(map);
+    if(map->entries) {
+        memset(map->ctrl, CTRL_EMPTY, ext_map_capacity(map) * sizeof(ctrl_t));
         map->num_entries = 0;
         map->size = 0;
     }
@@ -171,11 +678,38 @@ bool ext_map_empty(const ext_map* map) {
     return map->size == 0;
 }
 
-const void* ext_map_begin(const ext_map* map) {
-    if(!map->entries) return NULL;
+ext_map_statistics ext_map_stats(const ext_map* map) {
+    ext_map_statistics stats = {0};
+#ifdef EXTLIB_STATS
+    stats = map->stats;
+#endif
+    // Only the current table keeps track of its tombstones. The old one, only present during an
+    // incremental rehash, is going away and its tombstones with it
+    stats.tombstones = map->num_entries - (map->size - map->old_size);
+    return stats;
+}
 
-    for(size_t i = 0; i <= map->capacity_mask; i++) {
-        if(IS_VALID(&map->buckets[i])) {
+void ext_map_reset_stats(ext_map* map) {
+#ifdef EXTLIB_STATS
+    memset(&map->stats, 0, sizeof(map->stats));
+#else
+    UNUSED(map);
+#endif
+}
+
+// During an incremental rehash iteration first visits the entries left in the old table, and then
+// moves on to the current one
+static const void* next_valid(const ext_map* map, size_t old_start, size_t start) {
+    if(map->old_entries) {
+        for(size_t i = old_start; i <= map->old_capacity_mask; i++) {
+            if(IS_VALID(map->old_ctrl[i])) {
+                return map->old_entries + i * map->entry_sz;
+            }
+        }
+    }
+
+    for(size_t i = start; i <= map->capacity_mask; i++) {
+        if(IS_VALID(map->ctrl[i])) {
             return map->entries + i * map->entry_sz;
         }
     }
@@ -183,23 +717,339 @@ const void* ext_map_begin(const ext_map* map) {
     return ext_map_end(map);
 }
 
+const void* ext_map_begin(const ext_map* map) {
+    if(!map->entries) return NULL;
+    return next_valid(map, 0, 0);
+}
+
 const void* ext_map_end(const ext_map* map) {
     return map->entries ? map->entries + ext_map_capacity(map) * map->entry_sz : NULL;
 }
 
-static size_t iterator_index(const ext_map* map, const void* it) {
-    return (it - map->entries) / map->entry_sz;
+static bool in_old_table(const ext_map* map, const void* it) {
+    return map->old_entries && it >= map->old_entries &&
+           it < map->old_entries + (map->old_capacity_mask + 1) * map->entry_sz;
 }
 
 const void* ext_map_incr(const ext_map* map, const void* it) {
-    for(size_t i = iterator_index(map, it) + 1; i <= map->capacity_mask; i++) {
-        if(IS_VALID(&map->buckets[i])) {
-            return map->entries + i * map->entry_sz;
+    if(in_old_table(map, it)) {
+        return next_valid(map, (it - map->old_entries) / map->entry_sz + 1, 0);
+    }
+    return next_valid(map, (size_t)-1, (it - map->entries) / map->entry_sz + 1);
+}
+
+// -----------------------------------------------------------------------------
+// SNAPSHOTS
+// -----------------------------------------------------------------------------
+
+// A saved map is made of a header followed by the control bytes and entries of the current table
+// and, if an incremental rehash was in progress, of the old one. Every part starts at a multiple of
+// `FILE_ALIGNMENT`, so that once mapped the entries are suitably aligned for any type.
+
+#define FILE_MAGIC      "EXTMAP\r\n"  // The line endings catch files mangled by text mode transfers
+#define FILE_BYTE_ORDER 0x01020304u
+
+typedef struct map_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;  // FILE_BYTE_ORDER as written by the saving machine
+    uint32_t hash_id;
+    uint32_t reserved;
+    uint64_t entry_sz;
+    uint64_t capacity;
+    uint64_t num_entries;
+    uint64_t size;
+    uint64_t old_capacity;  // 0 if no rehash was in progress
+    uint64_t old_size;
+    uint64_t rehash_idx;
+} map_file_header;
+
+typedef struct map_file_layout {
+    uint64_t ctrl, entries, old_ctrl, old_entries;
+    uint64_t size;  // Size of the whole file
+} map_file_layout;
+
+static uint64_t file_align(uint64_t offset) {
+    return (offset + FILE_ALIGNMENT - 1) & ~(uint64_t)(FILE_ALIGNMENT - 1);
+}
+
+// Returns false if the header describes tables too big to be addressed
+static bool file_layout(const map_file_header* header, map_file_layout* layout) {
+    uint64_t max_capacity = UINT64_MAX / 4 / (header->entry_sz + 1);
+    if(header->capacity > max_capacity || header->old_capacity > max_capacity) return false;
+
+    uint64_t offset = file_align(sizeof(*header));
+    layout->ctrl = offset;
+    offset = file_align(offset + header->capacity);
+    layout->entries = offset;
+    offset = file_align(offset + header->capacity * header->entry_sz);
+    layout->old_ctrl = offset;
+    offset = file_align(offset + header->old_capacity);
+    layout->old_entries = offset;
+    offset += header->old_capacity * header->entry_sz;
+    layout->size = offset;
+    return layout->size <= SIZE_MAX;
+}
+
+static bool write_zeros(FILE* file, uint64_t amount) {
+    static const char zeros[FILE_ALIGNMENT];
+    while(amount) {
+        size_t chunk = amount < sizeof(zeros) ? amount : sizeof(zeros);
+        if(fwrite(zeros, 1, chunk, file) != chunk) return false;
+        amount -= chunk;
+    }
+    return true;
+}
+
+// Writes the entries of a table. The content of free slots is undefined, so they're zeroed to keep
+// the file deterministic
+static bool write_entries(FILE* file, const ext_map* map, const ctrl_t* ctrl, void* entries,
+                          size_t capacity) {
+    char buf[64 * 1024];
+    size_t per_chunk = map->entry_sz <= sizeof(buf) ? sizeof(buf) / map->entry_sz : 0;
+    if(!per_chunk) {
+        // Huge entries, write them one by one
+        for(size_t i = 0; i < capacity; i++) {
+            const void* entry = entry_at(entries, map->entry_sz, i);
+            if(IS_VALID(ctrl[i]) ? fwrite(entry, map->entry_sz, 1, file) != 1
+                                 : !write_zeros(file, map->entry_sz)) {
+                return false;
+            }
         }
+        return true;
     }
-    return ext_map_end(map);
+
+    for(size_t base = 0; base < capacity; base += per_chunk) {
+        size_t count = capacity - base < per_chunk ? capacity - base : per_chunk;
+        memcpy(buf, entry_at(entries, map->entry_sz, base), count * map->entry_sz);
+        for(size_t i = 0; i < count; i++) {
+            if(!IS_VALID(ctrl[base + i])) memset(buf + i * map->entry_sz, 0, map->entry_sz);
+        }
+        if(fwrite(buf, map->entry_sz, count, file) != count) return false;
+    }
+    return true;
+}
+
+static bool write_table(FILE* file, const ext_map* map, const ctrl_t* ctrl, void* entries,
+                        size_t capacity, uint64_t* offset, uint64_t ctrl_offset,
+                        uint64_t entries_offset) {
+    if(!capacity) return true;
+    if(!write_zeros(file, ctrl_offset - *offset)) return false;
+    if(fwrite(ctrl, sizeof(ctrl_t), capacity, file) != capacity) return false;
+    *offset = ctrl_offset + capacity;
+
+    if(!write_zeros(file, entries_offset - *offset)) return false;
+    if(!write_entries(file, map, ctrl, entries, capacity)) return false;
+    *offset = entries_offset + (uint64_t)capacity * map->entry_sz;
+    return true;
+}
+
+bool ext_map_save(const ext_map* map, FILE* file, uint32_t hash_id) {
+    map_file_header header = {0};
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = EXT_MAP_FILE_VERSION;
+    header.byte_order = FILE_BYTE_ORDER;
+    header.hash_id = hash_id;
+    header.entry_sz = map->entry_sz;
+    header.capacity = ext_map_capacity(map);
+    header.num_entries = map->num_entries;
+    header.size = map->size;
+    if(map->old_entries) {
+        header.old_capacity = map->old_capacity_mask + 1;
+        header.old_size = map->old_size;
+        header.rehash_idx = map->rehash_idx;
+    }
+
+    map_file_layout layout;
+    if(!file_layout(&header, &layout)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(fwrite(&header, sizeof(header), 1, file) != 1) return false;
+    uint64_t offset = sizeof(header);
+    if(!write_table(file, map, map->ctrl, map->entries, header.capacity, &offset, layout.ctrl,
+                    layout.entries)) {
+        return false;
+    }
+    if(!write_table(file, map, map->old_ctrl, map->old_entries, header.old_capacity, &offset,
+                    layout.old_ctrl, layout.old_entries)) {
+        return false;
+    }
+    return write_zeros(file, layout.size - offset) && fflush(file) == 0;
+}
+
+#if defined(MAP_MMAP_POSIX)
+
+static void* map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if(!S_ISREG(st.st_mode) || (uint64_t)st.st_size < sizeof(map_file_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+
+    *size = st.st_size;
+    return data;
+}
+
+static void unmap_file(void* data, size_t size) {
+    munmap(data, size);
+}
+
+#elif defined(MAP_MMAP_WIN32)
+
+static void* map_file(const char* path, size_t* size) {
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if(handle == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(handle, &file_size) ||
+       (uint64_t)file_size.QuadPart < sizeof(map_file_header)) {
+        CloseHandle(handle);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if(!mapping) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // The view keeps the mapping alive, so the handle can be closed right away
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(!data) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    *size = (size_t)file_size.QuadPart;
+    return data;
+}
+
+static void unmap_file(void* data, size_t size) {
+    UNUSED(size);
+    UnmapViewOfFile(data);
+}
+
+#else
+
+// No memory mapping available, read the whole file in memory
+static void* map_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if(!f) return NULL;
+
+    long file_size = -1;
+    if(fseek(f, 0, SEEK_END) == 0) file_size = ftell(f);
+    if(file_size < (long)sizeof(map_file_header) || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void* data = EXT_MALLOC(file_size);
+    if(!data) {
+        fclose(f);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if(fread(data, 1, file_size, f) != (size_t)file_size) {
+        EXT_FREE(data);
+        fclose(f);
+        errno = EIO;
+        return NULL;
+    }
+
+    fclose(f);
+    *size = file_size;
+    return data;
+}
+
+static void unmap_file(void* data, size_t size) {
+    UNUSED(size);
+    EXT_FREE(data);
+}
+
+#endif
+
+static bool valid_header(const map_file_header* header, size_t file_size, size_t entry_sz,
+                         uint32_t hash_id, map_file_layout* layout) {
+    if(memcmp(header->magic, FILE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if(header->version != EXT_MAP_FILE_VERSION || header->byte_order != FILE_BYTE_ORDER) {
+        return false;
+    }
+    if(header->hash_id != hash_id || header->entry_sz != entry_sz) return false;
+
+    // Capacities must be multiples of the group width, and powers of two
+    uint64_t caps[] = {header->capacity, header->old_capacity};
+    for(int i = 0; i < 2; i++) {
+        if(caps[i] && (caps[i] % GROUP_WIDTH || (caps[i] & (caps[i] - 1)))) return false;
+    }
+    if(header->size < header->old_size || header->num_entries > header->capacity ||
+       header->old_size > header->old_capacity || header->rehash_idx > header->old_capacity) {
+        return false;
+    }
+
+    return file_layout(header, layout) && layout->size <= file_size;
+}
+
+ext_map* ext_map_open_mapped(const char* path, size_t entry_sz, hash_fn hash, compare_fn compare,
+                             uint32_t hash_id) {
+    size_t file_size;
+    char* data = map_file(path, &file_size);
+    if(!data) return NULL;
+
+    map_file_header header;
+    memcpy(&header, data, sizeof(header));
+    map_file_layout layout;
+    if(!valid_header(&header, file_size, entry_sz, hash_id, &layout)) {
+        unmap_file(data, file_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ext_map* map = ext_map_new(entry_sz, hash, compare);
+    map->file_data = data;
+    map->file_size = file_size;
+    map->num_entries = header.num_entries;
+    map->size = header.size;
+    if(header.capacity) {
+        map->capacity_mask = header.capacity - 1;
+        map->ctrl = (ctrl_t*)(data + layout.ctrl);
+        map->entries = data + layout.entries;
+    }
+    if(header.old_capacity) {
+        map->old_capacity_mask = header.old_capacity - 1;
+        map->old_size = header.old_size;
+        map->rehash_idx = header.rehash_idx;
+        map->old_ctrl = (ctrl_t*)(data + layout.old_ctrl);
+        map->old_entries = data + layout.old_entries;
+    }
+    return map;
 }
 
+// -----------------------------------------------------------------------------
+// HASH FUNCTIONS
+// -----------------------------------------------------------------------------
+
 uint32_t ext_map_hash_bytes(const void* bytes, size_t size) {
     const unsigned char* data = bytes;
     uint32_t hash = 2166136261u;
@@ -208,4 +1058,103 @@ uint32_t ext_map_hash_bytes(const void* bytes, size_t size) {
         hash *= 16777619;
     }
     return hash;
-}
\ No newline at end of file
+}
+
+// -----------------------------------------------------------------------------
+// FAST HASH
+// -----------------------------------------------------------------------------
+
+// A hash function in the style of wyhash, that consumes the input 8 or 16 bytes at a time and
+// mixes it using 64x64->128 bit multiplications
+
+#define WY_P0 0xa0761d6478bd642full
+#define WY_P1 0xe7037ed1a0b428dbull
+#define WY_P2 0x8ebc6af09c88c6e3ull
+#define WY_P3 0x589965cc75374cc3ull
+
+static void wy_mum(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static uint64_t wy_mix(uint64_t a, uint64_t b) {
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t wy_read8(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t wy_read4(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t wy_read3(const unsigned char* p, size_t k) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t ext_map_hash_bytes_fast64(const void* bytes, size_t size) {
+    const unsigned char* p = bytes;
+    uint64_t seed = wy_mix(WY_P0, WY_P1);
+    uint64_t a, b;
+
+    if(size <= 16) {
+        if(size >= 4) {
+            a = (wy_read4(p) << 32) | wy_read4(p + ((size >> 3) << 2));
+            b = (wy_read4(p + size - 4) << 32) | wy_read4(p + size - 4 - ((size >> 3) << 2));
+        } else if(size > 0) {
+            a = wy_read3(p, size);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = size;
+        if(i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wy_mix(wy_read8(p) ^ WY_P1, wy_read8(p + 8) ^ seed);
+                see1 = wy_mix(wy_read8(p + 16) ^ WY_P2, wy_read8(p + 24) ^ see1);
+                see2 = wy_mix(wy_read8(p + 32) ^ WY_P3, wy_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = wy_mix(wy_read8(p) ^ WY_P1, wy_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = wy_read8(p + i - 16);
+        b = wy_read8(p + i - 8);
+    }
+
+    a ^= WY_P1;
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ WY_P0 ^ size, b ^ WY_P1);
+}
+
+uint32_t ext_map_hash_bytes_fast(const void* bytes, size_t size) {
+    uint64_t hash = ext_map_hash_bytes_fast64(bytes, size);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
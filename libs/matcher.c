@@ -0,0 +1,209 @@
+#include "extlib/matcher.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+
+#define ROOT     0
+#define NO_STATE UINT32_MAX
+#define NO_MATCH UINT32_MAX
+
+struct ext_matcher {
+    size_t num_patterns;
+    size_t* lengths;         // Length of every pattern
+    uint32_t* dups;          // Next pattern equal to this one, NO_MATCH if none
+    size_t num_states;
+    size_t num_classes;
+    uint8_t classes[256];    // Byte class of every byte
+    uint32_t* delta;         // Transitions, num_states * num_classes
+    uint32_t* matches;       // Longest pattern ending in a state, NO_MATCH if none
+    uint32_t* dict_links;    // Nearest state on the failure chain with a match, ROOT if none
+    uint8_t* reports;        // Whether reaching the state reports at least one match
+};
+
+static void compute_classes(ext_matcher* m, const ext_strview* patterns, size_t count) {
+    bool used[256] = {false};
+    size_t num_used = 0;
+    for(size_t i = 0; i < count; i++) {
+        for(size_t j = 0; j < patterns[i].size; j++) {
+            unsigned char c = patterns[i].data[j];
+            if(!used[c]) num_used++;
+            used[c] = true;
+        }
+    }
+
+    // Class 0 is shared by all bytes that don't appear in any pattern. When the patterns use every
+    // byte value there are none left, and class 0 isn't reserved so that all classes fit in a byte
+    m->num_classes = num_used < 256 ? 1 : 0;
+    for(size_t c = 0; c < 256; c++) {
+        m->classes[c] = used[c] ? m->num_classes++ : 0;
+    }
+}
+
+static uint32_t* transition(const ext_matcher* m, uint32_t state, unsigned char cls) {
+    return &m->delta[state * m->num_classes + cls];
+}
+
+static void build_trie(ext_matcher* m, const ext_strview* patterns, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        if(patterns[i].size == 0) continue;
+
+        uint32_t state = ROOT;
+        for(size_t j = 0; j < patterns[i].size; j++) {
+            uint32_t* next = transition(m, state, m->classes[(unsigned char)patterns[i].data[j]]);
+            if(*next == NO_STATE) *next = m->num_states++;
+            state = *next;
+        }
+
+        if(m->matches[state] == NO_MATCH) {
+            m->matches[state] = i;
+        } else {
+            // Chain duplicate patterns, keeping them ordered by index
+            uint32_t last = m->matches[state];
+            while(m->dups[last] != NO_MATCH) last = m->dups[last];
+            m->dups[last] = i;
+        }
+    }
+}
+
+// Computes failure links breadth-first, and uses them to turn the trie into a complete automaton
+static void build_automaton(ext_matcher* m) {
+    uint32_t* fail = EXT_MALLOC(m->num_states * sizeof(*fail));
+    uint32_t* queue = EXT_MALLOC(m->num_states * sizeof(*queue));
+    ASSERT(fail && queue, "Out of memory");
+
+    size_t head = 0, tail = 0;
+    for(size_t c = 0; c < m->num_classes; c++) {
+        uint32_t* next = transition(m, ROOT, c);
+        if(*next == NO_STATE) {
+            *next = ROOT;
+        } else {
+            fail[*next] = ROOT;
+            m->dict_links[*next] = ROOT;
+            queue[tail++] = *next;
+        }
+    }
+
+    while(head < tail) {
+        uint32_t state = queue[head++];
+        for(size_t c = 0; c < m->num_classes; c++) {
+            uint32_t* next = transition(m, state, c);
+            uint32_t fallback = *transition(m, fail[state], c);
+            if(*next == NO_STATE) {
+                *next = fallback;
+            } else {
+                fail[*next] = fallback;
+                m->dict_links[*next] = m->matches[fallback] != NO_MATCH ? fallback
+                                                                        : m->dict_links[fallback];
+                queue[tail++] = *next;
+            }
+        }
+    }
+
+    for(size_t s = 0; s < m->num_states; s++) {
+        m->reports[s] = m->matches[s] != NO_MATCH || m->dict_links[s] != ROOT;
+    }
+
+    EXT_FREE(fail);
+    EXT_FREE(queue);
+}
+
+ext_matcher* ext_matcher_new(const ext_strview* patterns, size_t count) {
+    ext_matcher* m = EXT_MALLOC(sizeof(*m));
+    ASSERT(m, "Out of memory");
+
+    size_t max_states = 1;
+    for(size_t i = 0; i < count; i++) {
+        max_states += patterns[i].size;
+    }
+    ASSERT(max_states < NO_STATE && count < NO_MATCH, "Too many patterns");
+
+    compute_classes(m, patterns, count);
+
+    m->num_patterns = count;
+    m->num_states = 1;
+    m->lengths = EXT_MALLOC(count * sizeof(*m->lengths) + 1);
+    m->dups = EXT_MALLOC(count * sizeof(*m->dups) + 1);
+    m->delta = EXT_MALLOC(max_states * m->num_classes * sizeof(*m->delta));
+    m->matches = EXT_MALLOC(max_states * sizeof(*m->matches));
+    m->dict_links = EXT_MALLOC(max_states * sizeof(*m->dict_links));
+    ASSERT(m->lengths && m->dups && m->delta && m->matches && m->dict_links, "Out of memory");
+
+    for(size_t i = 0; i < count; i++) {
+        m->lengths[i] = patterns[i].size;
+        m->dups[i] = NO_MATCH;
+    }
+    memset(m->delta, 0xff, max_states * m->num_classes * sizeof(*m->delta));  // NO_STATE
+    memset(m->matches, 0xff, max_states * sizeof(*m->matches));                // NO_MATCH
+    m->dict_links[ROOT] = ROOT;
+
+    build_trie(m, patterns, count);
+
+    // Release the memory reserved for states that weren't needed (shared prefixes)
+    uint32_t* delta = EXT_REALLOC(m->delta, m->num_states * m->num_classes * sizeof(*m->delta));
+    if(delta) m->delta = delta;
+    m->reports = EXT_MALLOC(m->num_states * sizeof(*m->reports));
+    ASSERT(m->reports, "Out of memory");
+
+    build_automaton(m);
+    return m;
+}
+
+void ext_matcher_free(ext_matcher* matcher) {
+    EXT_FREE(matcher->lengths);
+    EXT_FREE(matcher->dups);
+    EXT_FREE(matcher->delta);
+    EXT_FREE(matcher->matches);
+    EXT_FREE(matcher->dict_links);
+    EXT_FREE(matcher->reports);
+    EXT_FREE(matcher);
+}
+
+bool ext_matcher_find_any(const ext_matcher* matcher, ext_strview text, ext_match* match) {
+    const uint32_t* delta = matcher->delta;
+    size_t num_classes = matcher->num_classes;
+
+    uint32_t state = ROOT;
+    for(size_t i = 0; i < text.size; i++) {
+        state = delta[state * num_classes + matcher->classes[(unsigned char)text.data[i]]];
+        if(matcher->reports[state]) {
+            // The pattern of the state itself, if any, is longer than all the ones on its
+            // dictionary links
+            uint32_t s = matcher->matches[state] != NO_MATCH ? state : matcher->dict_links[state];
+            uint32_t pattern = matcher->matches[s];
+            if(match) *match = (ext_match){pattern, i + 1 - matcher->lengths[pattern]};
+            return true;
+        }
+    }
+
+    return false;
+}
+
+ext_vector(ext_match) ext_matcher_find_all(const ext_matcher* matcher, ext_strview text) {
+    ext_vector(ext_match) matches = NULL;
+    const uint32_t* delta = matcher->delta;
+    size_t num_classes = matcher->num_classes;
+
+    uint32_t state = ROOT;
+    for(size_t i = 0; i < text.size; i++) {
+        state = delta[state * num_classes + matcher->classes[(unsigned char)text.data[i]]];
+        if(!matcher->reports[state]) continue;
+
+        uint32_t s = matcher->matches[state] != NO_MATCH ? state : matcher->dict_links[state];
+        while(s != ROOT) {
+            for(uint32_t p = matcher->matches[s]; p != NO_MATCH; p = matcher->dups[p]) {
+                ext_match match = {p, i + 1 - matcher->lengths[p]};
+                ext_vec_push_back(matches, match);
+            }
+            s = matcher->dict_links[s];
+        }
+    }
+
+    return matches;
+}
+
+size_t ext_matcher_num_patterns(const ext_matcher* matcher) {
+    return matcher->num_patterns;
+}
@@ -0,0 +1,274 @@
+#include "extlib/sort.h"
+
+#include <string.h>
+
+#include "extlib/alloc.h"
+#include "extlib/assert.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+#define MAX_THREADS 64
+#define MIN_RUN     4096  // Don't split the array in runs smaller than this amount of elements
+
+// -----------------------------------------------------------------------------
+// RADIX SORT
+// -----------------------------------------------------------------------------
+
+enum key_kind {
+    KEY_UNSIGNED,
+    KEY_SIGNED,
+    KEY_FLOAT,
+};
+
+// Keys are transformed in place to unsigned integers that compare in the same order, sorted, and
+// then transformed back. They are always accessed through memcpy, so that floats can be sorted
+// without breaking strict aliasing rules.
+#define RADIX_SORT(bits)                                                                    \
+    typedef uint##bits##_t key##bits##_t;                                                   \
+                                                                                            \
+    static key##bits##_t load_##bits(const char* p, size_t i) {                             \
+        key##bits##_t k;                                                                    \
+        memcpy(&k, p + i * sizeof(k), sizeof(k));                                           \
+        return k;                                                                           \
+    }                                                                                       \
+                                                                                            \
+    static void store_##bits(char* p, size_t i, key##bits##_t k) {                          \
+        memcpy(p + i * sizeof(k), &k, sizeof(k));                                           \
+    }                                                                                       \
+                                                                                            \
+    static key##bits##_t to_ordered_##bits(key##bits##_t k, enum key_kind kind) {           \
+        const key##bits##_t sign = (key##bits##_t)1 << (bits - 1);                          \
+        switch(kind) {                                                                      \
+        case KEY_SIGNED:                                                                    \
+            return k ^ sign;                                                                \
+        case KEY_FLOAT:                                                                     \
+            return k & sign ? ~k : k ^ sign;                                                \
+        default:                                                                            \
+            return k;                                                                       \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static key##bits##_t from_ordered_##bits(key##bits##_t k, enum key_kind kind) {         \
+        const key##bits##_t sign = (key##bits##_t)1 << (bits - 1);                          \
+        switch(kind) {                                                                      \
+        case KEY_SIGNED:                                                                    \
+            return k ^ sign;                                                                \
+        case KEY_FLOAT:                                                                     \
+            return k & sign ? k ^ sign : ~k;                                                \
+        default:                                                                            \
+            return k;                                                                       \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static void radix_sort_##bits(void* keys, size_t count, enum key_kind kind) {           \
+        enum { DIGITS = bits / 8 };                                                         \
+        if(count < 2) return;                                                               \
+                                                                                            \
+        /* Compute the histograms of all digits in a single pass */                         \
+        size_t hist[DIGITS][256] = {{0}};                                                   \
+        for(size_t i = 0; i < count; i++) {                                                 \
+            key##bits##_t k = to_ordered_##bits(load_##bits(keys, i), kind);                \
+            store_##bits(keys, i, k);                                                       \
+            for(int d = 0; d < DIGITS; d++) hist[d][(k >> (d * 8)) & 0xff]++;               \
+        }                                                                                   \
+                                                                                            \
+        char* buf = EXT_MALLOC(count * sizeof(key##bits##_t));                              \
+        ASSERT(buf, "Out of memory");                                                       \
+        char *src = keys, *dst = buf;                                                       \
+                                                                                            \
+        for(int d = 0; d < DIGITS; d++) {                                                   \
+            /* Skip the pass if all keys have the same digit */                             \
+            if(hist[d][(load_##bits(src, 0) >> (d * 8)) & 0xff] == count) continue;         \
+                                                                                            \
+            size_t offset = 0;                                                              \
+            for(int b = 0; b < 256; b++) {                                                  \
+                size_t c = hist[d][b];                                                      \
+                hist[d][b] = offset;                                                        \
+                offset += c;                                                                \
+            }                                                                               \
+            for(size_t i = 0; i < count; i++) {                                             \
+                key##bits##_t k = load_##bits(src, i);                                      \
+                store_##bits(dst, hist[d][(k >> (d * 8)) & 0xff]++, k);                     \
+            }                                                                               \
+                                                                                            \
+            char* tmp = src;                                                                \
+            src = dst;                                                                      \
+            dst = tmp;                                                                      \
+        }                                                                                   \
+                                                                                            \
+        if(src != (char*)keys) memcpy(keys, src, count * sizeof(key##bits##_t));            \
+        EXT_FREE(buf);                                                                      \
+                                                                                            \
+        for(size_t i = 0; i < count; i++) {                                                 \
+            store_##bits(keys, i, from_ordered_##bits(load_##bits(keys, i), kind));         \
+        }                                                                                   \
+    }
+
+RADIX_SORT(32)
+RADIX_SORT(64)
+
+void ext_radix_sort_u32(uint32_t* keys, size_t count) {
+    radix_sort_32(keys, count, KEY_UNSIGNED);
+}
+
+void ext_radix_sort_u64(uint64_t* keys, size_t count) {
+    radix_sort_64(keys, count, KEY_UNSIGNED);
+}
+
+void ext_radix_sort_i32(int32_t* keys, size_t count) {
+    radix_sort_32(keys, count, KEY_SIGNED);
+}
+
+void ext_radix_sort_i64(int64_t* keys, size_t count) {
+    radix_sort_64(keys, count, KEY_SIGNED);
+}
+
+void ext_radix_sort_f32(float* keys, size_t count) {
+    radix_sort_32(keys, count, KEY_FLOAT);
+}
+
+void ext_radix_sort_f64(double* keys, size_t count) {
+    radix_sort_64(keys, count, KEY_FLOAT);
+}
+
+// -----------------------------------------------------------------------------
+// PARALLEL SORT
+// -----------------------------------------------------------------------------
+
+// A task either sorts the run [start, end) of `src` in place, or merges the runs [start, mid) and
+// [mid, end) of `src` into `dst`
+typedef struct sort_task {
+    ext_sort_fn sort;
+    ext_merge_fn merge;
+    char *src, *dst;
+    size_t size;
+    size_t start, mid, end;
+} sort_task;
+
+static void run_task(sort_task* t) {
+    if(t->sort) {
+        t->sort(t->src + t->start * t->size, t->end - t->start);
+    } else {
+        t->merge(t->src + t->start * t->size, t->mid - t->start, t->src + t->mid * t->size,
+                 t->end - t->mid, t->dst + t->start * t->size);
+    }
+}
+
+#ifdef _WIN32
+
+typedef HANDLE thread_t;
+
+static DWORD WINAPI thread_main(LPVOID arg) {
+    run_task(arg);
+    return 0;
+}
+
+static bool thread_start(thread_t* thread, sort_task* task) {
+    *thread = CreateThread(NULL, 0, thread_main, task, 0, NULL);
+    return *thread != NULL;
+}
+
+static void thread_join(thread_t thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static int cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+
+typedef pthread_t thread_t;
+
+static void* thread_main(void* arg) {
+    run_task(arg);
+    return NULL;
+}
+
+static bool thread_start(thread_t* thread, sort_task* task) {
+    return pthread_create(thread, NULL, thread_main, task) == 0;
+}
+
+static void thread_join(thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
+static int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
+
+#endif
+
+// Runs all tasks concurrently, the first one on the calling thread. If a thread cannot be started
+// its task is run on the calling thread as well.
+static void run_tasks(sort_task* tasks, int count) {
+    thread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for(int i = 1; i < count; i++) {
+        started[i] = thread_start(&threads[i], &tasks[i]);
+    }
+    run_task(&tasks[0]);
+    for(int i = 1; i < count; i++) {
+        if(started[i]) {
+            thread_join(threads[i]);
+        } else {
+            run_task(&tasks[i]);
+        }
+    }
+}
+
+void ext_sort_parallel(void* base, size_t count, size_t size, ext_sort_fn sort, ext_merge_fn merge,
+                       int num_threads) {
+    size_t runs = num_threads > 0 ? num_threads : cpu_count();
+    if(runs > MAX_THREADS) runs = MAX_THREADS;
+    if(runs > count / MIN_RUN) runs = count / MIN_RUN;
+    if(runs <= 1) {
+        sort(base, count);
+        return;
+    }
+
+    size_t bounds[MAX_THREADS + 1];
+    sort_task tasks[MAX_THREADS];
+    for(size_t i = 0; i <= runs; i++) {
+        bounds[i] = count * i / runs;
+    }
+    for(size_t i = 0; i < runs; i++) {
+        tasks[i] = (sort_task){sort, NULL, base, NULL, size, bounds[i], 0, bounds[i + 1]};
+    }
+    run_tasks(tasks, runs);
+
+    char* buf = EXT_MALLOC(count * size);
+    ASSERT(buf, "Out of memory");
+
+    // Merge pairs of adjacent runs, halving their number at each round. An odd run out is merged
+    // with an empty one, i.e. simply copied.
+    char *src = base, *dst = buf;
+    while(runs > 1) {
+        size_t merges = 0;
+        for(size_t i = 0; i < runs; i += 2) {
+            size_t mid = bounds[i + 1];
+            size_t end = i + 1 < runs ? bounds[i + 2] : bounds[i + 1];
+            tasks[merges] = (sort_task){NULL, merge, src, dst, size, bounds[i], mid, end};
+            bounds[merges++] = bounds[i];
+        }
+        bounds[merges] = count;
+        run_tasks(tasks, merges);
+
+        runs = merges;
+        char* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if(src != (char*)base) memcpy(base, src, count * size);
+    EXT_FREE(buf);
+}
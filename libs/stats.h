@@ -0,0 +1,61 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Private helpers for the instrumentation counters, compiled in only when EXTLIB_STATS is defined.
+// Counters are updated with relaxed atomic operations where available, as some of them are bumped
+// by read-only operations that may run concurrently (e.g. lookups on an ext_cmap shard).
+
+#ifdef EXTLIB_STATS
+
+    #include <stdint.h>
+
+    #if defined(__GNUC__) || defined(__clang__)
+        #define STAT_ADD(counter, n) ((void)__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED))
+        #define STAT_MAX(counter, v)                                                           \
+            do {                                                                               \
+                __typeof__(counter) __cur = __atomic_load_n(&(counter), __ATOMIC_RELAXED);     \
+                while((v) > __cur && !__atomic_compare_exchange_n(&(counter), &__cur, (v), 1, \
+                                                                  __ATOMIC_RELAXED,            \
+                                                                  __ATOMIC_RELAXED)) {         \
+                }                                                                              \
+            } while(0)
+    #else
+        #define STAT_ADD(counter, n) ((void)((counter) += (n)))
+        #define STAT_MAX(counter, v)                 \
+            do {                                     \
+                if((v) > (counter)) (counter) = (v); \
+            } while(0)
+    #endif
+
+    #if defined(_WIN32)
+        #include <windows.h>
+static inline uint64_t stat_now_ns(void) {
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / freq.QuadPart);
+}
+    #else
+        #include <time.h>
+static inline uint64_t stat_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+    #endif
+
+    #define STAT_TIMER_START(name) uint64_t name = stat_now_ns()
+    #define STAT_TIMER_STOP(name, counter) STAT_ADD(counter, stat_now_ns() - (name))
+
+#else
+
+    #define STAT_ADD(counter, n)           ((void)0)
+    #define STAT_MAX(counter, v)           ((void)0)
+    #define STAT_TIMER_START(name)         ((void)0)
+    #define STAT_TIMER_STOP(name, counter) ((void)0)
+
+#endif
+
+#define STAT_INC(counter) STAT_ADD(counter, 1)
+
+#endif  // STATS_H
@@ -1,60 +1,932 @@
 #include "extlib/string.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "extlib/assert.h"
+#include "extlib/map.h"
+#include "stats.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #define STR_MMAP_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define STR_MMAP_POSIX
+#endif
+
+#define SLOW_GROWTH_TRESH  (1024 * 1024)  // Grow by 1.5x instead of 2x after this capacity
+#define BUILDER_CHUNK_MIN  256
+#define BUILDER_CHUNK_MAX  (1024 * 1024)
+#define READ_BUF_SIZE      (64 * 1024)
+
+// -----------------------------------------------------------------------------
+// SUBSTRING SEARCH
+// -----------------------------------------------------------------------------
+
+// Needles are searched using a SIMD filter on their first and last bytes. If the filter lets through
+// too many false candidates the search switches to the Two-Way algorithm, that has linear worst
+// case. The filter is allowed to waste this many byte comparisons before the check kicks in.
+#define FILTER_SLACK 1024
+#define BLOCK_WIDTH  16
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define STR_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define STR_NEON
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
+typedef uint64_t bitmask_t;
+
+#ifdef STR_NEON
+    // NEON has no movemask instruction, so we narrow the comparison result to 4 bits per byte and
+    // keep only the top bit of every nibble
+    #define BITMASK_SHIFT 2
+#else
+    #define BITMASK_SHIFT 0
+#endif
+
+static int count_trailing_zeros(bitmask_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanForward64(&idx, mask);
+    return idx;
+#else
+    int count = 0;
+    while(!(mask & 1)) {
+        mask >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
 
-#define LOGARITHMIC_GROWTH_TRESH (1024 * 1024)
-#define ext_str_header(s)        ((str_header_t*)(s - sizeof(str_header_t)))
+static int count_leading_zeros(bitmask_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanReverse64(&idx, mask);
+    return 63 - idx;
+#else
+    int count = 0;
+    while(!(mask & ((bitmask_t)1 << 63))) {
+        mask <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
 
-typedef struct {
-    size_t capacity, size;
-    char data[];
-} str_header_t;
+#define BITMASK_LOWEST(mask)  (count_trailing_zeros(mask) >> BITMASK_SHIFT)
+#define BITMASK_HIGHEST(mask) ((63 - count_leading_zeros(mask)) >> BITMASK_SHIFT)
+#define BITMASK_NEXT(mask)    ((mask) & ((mask)-1))
+#define BITMASK_PREV(mask)    ((mask) & ~((bitmask_t)1 << (63 - count_leading_zeros(mask))))
 
-static void ext_str_set_size(ext_string* str, size_t size) {
-    ext_str_header(*str)->size = size;
+// Returns a bitmask with a bit set for every byte equal to `c` in the `BLOCK_WIDTH` bytes at `p`
+#if defined(STR_SSE2)
+
+static bitmask_t block_match(const char* p, char c) {
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
 }
 
-static void ext_str_maybe_grow(ext_string* str, size_t amount) {
-    str_header_t* header = ext_str_header(*str);
-    if(header->size + amount >= header->capacity) {
-        size_t new_capacity = header->capacity;
+#elif defined(STR_NEON)
+
+static bitmask_t block_match(const char* p, char c) {
+    uint8x16_t cmp = vceqq_u8(vld1q_u8((const uint8_t*)p), vdupq_n_u8((uint8_t)c));
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ull;
+}
+
+#else
+
+static bitmask_t block_match(const char* p, char c) {
+    bitmask_t mask = 0;
+    for(int i = 0; i < BLOCK_WIDTH; i++) {
+        if(p[i] == c) mask |= (bitmask_t)1 << i;
+    }
+    return mask;
+}
+
+#endif
+
+static const char* find_last_char(const char* hay, size_t n, char c) {
+    size_t end = n;
+    for(; end >= BLOCK_WIDTH; end -= BLOCK_WIDTH) {
+        bitmask_t mask = block_match(hay + end - BLOCK_WIDTH, c);
+        if(mask) return hay + end - BLOCK_WIDTH + BITMASK_HIGHEST(mask);
+    }
+    while(end-- > 0) {
+        if(hay[end] == c) return hay + end;
+    }
+    return NULL;
+}
+
+// Returns true when the bytes compared on false candidates are too many compared to the `scanned`
+// positions of the haystack, and the filter should give up
+static bool filter_exhausted(size_t wasted, size_t scanned) {
+    return wasted > 2 * scanned + FILTER_SLACK;
+}
+
+// Candidate positions are the ones where both the first and the last byte of the needle match.
+// Only on those we compare the rest of the needle. Requires n >= m >= 2.
+// If the filter is exhausted before finding a match, returns NULL and sets `*resume` to the first
+// position not yet checked, otherwise sets it to `n`.
+static const char* find_filtered(const char* hay, size_t n, const char* needle, size_t m,
+                                 size_t* resume) {
+    size_t last = n - m;  // Last valid starting position
+    size_t wasted = 0;
+    size_t i = 0;
+    for(; i + BLOCK_WIDTH <= last + 1; i += BLOCK_WIDTH) {
+        bitmask_t mask = block_match(hay + i, needle[0]) &
+                         block_match(hay + i + m - 1, needle[m - 1]);
+        for(; mask; mask = BITMASK_NEXT(mask)) {
+            size_t pos = i + BITMASK_LOWEST(mask);
+            if(memcmp(hay + pos + 1, needle + 1, m - 2) == 0) return hay + pos;
+            wasted += m - 2;
+            if(filter_exhausted(wasted, pos)) {
+                *resume = pos + 1;
+                return NULL;
+            }
+        }
+    }
+    for(; i <= last; i++) {
+        if(hay[i] == needle[0] && hay[i + m - 1] == needle[m - 1] &&
+           memcmp(hay + i + 1, needle + 1, m - 2) == 0) {
+            return hay + i;
+        }
+    }
+    *resume = n;
+    return NULL;
+}
 
-        if(new_capacity > LOGARITHMIC_GROWTH_TRESH) {
-            new_capacity += amount;
+// Same as above, but returns the last occurrence. If the filter is exhausted `*resume` is set to
+// the length of the prefix of the haystack that still has to be searched, otherwise to 0.
+static const char* rfind_filtered(const char* hay, size_t n, const char* needle, size_t m,
+                                  size_t* resume) {
+    size_t end = n - m + 1;  // One past the last valid starting position
+    size_t wasted = 0;
+    for(; end >= BLOCK_WIDTH; end -= BLOCK_WIDTH) {
+        size_t i = end - BLOCK_WIDTH;
+        bitmask_t mask = block_match(hay + i, needle[0]) &
+                         block_match(hay + i + m - 1, needle[m - 1]);
+        for(; mask; mask = BITMASK_PREV(mask)) {
+            size_t pos = i + BITMASK_HIGHEST(mask);
+            if(memcmp(hay + pos + 1, needle + 1, m - 2) == 0) return hay + pos;
+            wasted += m - 2;
+            if(filter_exhausted(wasted, n - m - pos)) {
+                *resume = pos + m - 1;
+                return NULL;
+            }
+        }
+    }
+    while(end-- > 0) {
+        if(hay[end] == needle[0] && hay[end + m - 1] == needle[m - 1] &&
+           memcmp(hay + end + 1, needle + 1, m - 2) == 0) {
+            return hay + end;
+        }
+    }
+    *resume = 0;
+    return NULL;
+}
+
+// Two-Way string matching (Crochemore and Perrin). The same implementation is used to search for
+// the last occurrence, by reading both the haystack and the needle backwards when `rev` is true.
+
+static inline unsigned char byte_at(const char* s, size_t len, ptrdiff_t i, bool rev) {
+    return (unsigned char)(rev ? s[len - 1 - i] : s[i]);
+}
+
+// Computes the maximal suffix of `x` w.r.t. the normal order of the alphabet (or the inverted one,
+// if `inverted` is true). Returns the position right before the start of the suffix.
+static ptrdiff_t max_suffix(const char* x, ptrdiff_t m, bool rev, bool inverted, ptrdiff_t* p) {
+    ptrdiff_t ms = -1, j = 0, k = 1;
+    *p = 1;
+    while(j + k < m) {
+        unsigned char a = byte_at(x, m, j + k, rev);
+        unsigned char b = byte_at(x, m, ms + k, rev);
+        if(inverted ? a > b : a < b) {
+            j += k;
+            k = 1;
+            *p = j - ms;
+        } else if(a == b) {
+            if(k != *p) {
+                k++;
+            } else {
+                j += *p;
+                k = 1;
+            }
         } else {
-            while(new_capacity <= header->size + amount) {
-                new_capacity *= 2;
+            ms = j;
+            j = ms + 1;
+            k = *p = 1;
+        }
+    }
+    return ms;
+}
+
+// Returns the position of the first occurrence of `x` in `y` (in the direction given by `rev`), or
+// -1 if not found
+static ptrdiff_t two_way(const char* y, ptrdiff_t n, const char* x, ptrdiff_t m, bool rev) {
+    ptrdiff_t p, q;
+    ptrdiff_t i = max_suffix(x, m, rev, false, &p);
+    ptrdiff_t j = max_suffix(x, m, rev, true, &q);
+
+    ptrdiff_t ell = i > j ? i : j;  // Critical factorization
+    ptrdiff_t per = i > j ? p : q;
+
+    bool periodic = true;
+    for(ptrdiff_t k = 0; k <= ell; k++) {
+        if(byte_at(x, m, k, rev) != byte_at(x, m, k + per, rev)) {
+            periodic = false;
+            break;
+        }
+    }
+
+#define X(k) byte_at(x, m, k, rev)
+#define Y(k) byte_at(y, n, k, rev)
+
+    if(periodic) {
+        // The needle is periodic: remember the length of the prefix matched in the previous window
+        // to avoid comparing it again
+        ptrdiff_t memory = -1;
+        for(j = 0; j <= n - m;) {
+            i = (ell > memory ? ell : memory) + 1;
+            while(i < m && X(i) == Y(i + j)) i++;
+            if(i >= m) {
+                i = ell;
+                while(i > memory && X(i) == Y(i + j)) i--;
+                if(i <= memory) return j;
+                j += per;
+                memory = m - per - 1;
+            } else {
+                j += i - ell;
+                memory = -1;
+            }
+        }
+    } else {
+        per = (ell + 1 > m - ell - 1 ? ell + 1 : m - ell - 1) + 1;
+        for(j = 0; j <= n - m;) {
+            i = ell + 1;
+            while(i < m && X(i) == Y(i + j)) i++;
+            if(i >= m) {
+                i = ell;
+                while(i >= 0 && X(i) == Y(i + j)) i--;
+                if(i < 0) return j;
+                j += per;
+            } else {
+                j += i - ell;
             }
         }
+    }
+
+#undef X
+#undef Y
+
+    return -1;
+}
+
+// Returns a pointer to the first occurrence of `needle` in `hay`, NULL if not found
+static const char* search_forward(const char* hay, size_t n, const char* needle, size_t m) {
+    if(m == 0) return hay;
+    if(n < m) return NULL;
+    if(m == 1) return memchr(hay, needle[0], n);
+
+    size_t resume;
+    const char* match = find_filtered(hay, n, needle, m, &resume);
+    if(match || n - resume < m) return match;
+    ptrdiff_t pos = two_way(hay + resume, n - resume, needle, m, false);
+    return pos < 0 ? NULL : hay + resume + pos;
+}
 
-        header = realloc(header, sizeof(*header) + new_capacity);
-        ASSERT(header, "Out of memory");
-        header->capacity = new_capacity;
+// Returns a pointer to the last occurrence of `needle` in `hay`, NULL if not found
+static const char* search_backward(const char* hay, size_t n, const char* needle, size_t m) {
+    if(m == 0) return hay + n;
+    if(n < m) return NULL;
+    if(m == 1) return find_last_char(hay, n, needle[0]);
+
+    size_t resume;
+    const char* match = rfind_filtered(hay, n, needle, m, &resume);
+    if(match || resume < m) return match;
+    ptrdiff_t pos = two_way(hay, resume, needle, m, true);
+    return pos < 0 ? NULL : hay + resume - m - pos;
+}
 
-        *str = header->data;
+// -----------------------------------------------------------------------------
+// ASCII CASE CONVERSION
+// -----------------------------------------------------------------------------
+
+// Upper and lower case ASCII letters only differ by this bit
+#define ASCII_CASE_BIT 0x20
+
+// Flips the case of all bytes in the range [lo, hi], that must only contain ASCII letters of the
+// same case
+#if defined(STR_SSE2)
+
+static void ascii_flip_case(char* s, size_t n, char lo, char hi) {
+    // Bytes >= 0x80 are negative when compared as signed, so they're never in range
+    __m128i vlo = _mm_set1_epi8(lo - 1), vhi = _mm_set1_epi8(hi + 1);
+    __m128i vbit = _mm_set1_epi8(ASCII_CASE_BIT);
+    size_t i = 0;
+    for(; i + BLOCK_WIDTH <= n; i += BLOCK_WIDTH) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(block, vlo), _mm_cmplt_epi8(block, vhi));
+        block = _mm_xor_si128(block, _mm_and_si128(in_range, vbit));
+        _mm_storeu_si128((__m128i*)(s + i), block);
+    }
+    for(; i < n; i++) {
+        if(s[i] >= lo && s[i] <= hi) s[i] ^= ASCII_CASE_BIT;
     }
 }
 
+#elif defined(STR_NEON)
+
+static void ascii_flip_case(char* s, size_t n, char lo, char hi) {
+    uint8x16_t vlo = vdupq_n_u8((uint8_t)lo), vhi = vdupq_n_u8((uint8_t)hi);
+    uint8x16_t vbit = vdupq_n_u8(ASCII_CASE_BIT);
+    size_t i = 0;
+    for(; i + BLOCK_WIDTH <= n; i += BLOCK_WIDTH) {
+        uint8x16_t block = vld1q_u8((const uint8_t*)(s + i));
+        uint8x16_t in_range = vandq_u8(vcgeq_u8(block, vlo), vcleq_u8(block, vhi));
+        vst1q_u8((uint8_t*)(s + i), veorq_u8(block, vandq_u8(in_range, vbit)));
+    }
+    for(; i < n; i++) {
+        if(s[i] >= lo && s[i] <= hi) s[i] ^= ASCII_CASE_BIT;
+    }
+}
+
+#else
+
+static void ascii_flip_case(char* s, size_t n, char lo, char hi) {
+    for(size_t i = 0; i < n; i++) {
+        if(s[i] >= lo && s[i] <= hi) s[i] ^= ASCII_CASE_BIT;
+    }
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// HEADER
+// -----------------------------------------------------------------------------
+
+// Similarly to Redis' sds, the size and capacity of a string are stored before its data using the
+// smallest integer type able to represent its capacity, so that short strings only pay 7 bytes of
+// overhead. The byte right before the data always holds the flags, that encode the type of the
+// header, whether a pointer to a custom allocator is stored before it and whether the cached hash
+// is valid. The hash always sits right before the flags, regardless of the type of the header:
+//
+//     [allocator (optional)][size][capacity][hash][flags][data...]
+
+#define STR_TYPE_8        0
+#define STR_TYPE_16       1
+#define STR_TYPE_32       2
+#define STR_TYPE_64       3
+#define STR_TYPE_MASK     0x07
+#define STR_HAS_ALLOCATOR 0x08
+#define STR_HASH_VALID    0x10
+
+#pragma pack(push, 1)
+typedef struct {
+    uint8_t size, capacity;
+    uint32_t hash;
+    uint8_t flags;
+} str_header8;
+
+typedef struct {
+    uint16_t size, capacity;
+    uint32_t hash;
+    uint8_t flags;
+} str_header16;
+
+typedef struct {
+    uint32_t size, capacity;
+    uint32_t hash;
+    uint8_t flags;
+} str_header32;
+
+typedef struct {
+    uint64_t size, capacity;
+    uint32_t hash;
+    uint8_t flags;
+} str_header64;
+#pragma pack(pop)
+
+#define STR_FLAGS(s)     ((uint8_t)(s)[-1])
+#define STR_TYPE(s)      (STR_FLAGS(s) & STR_TYPE_MASK)
+#define STR_HDR(T, s)    ((T*)((s) - sizeof(T)))
+
+static const size_t header_sizes[] = {
+    sizeof(str_header8),
+    sizeof(str_header16),
+    sizeof(str_header32),
+    sizeof(str_header64),
+};
+
+static int type_for_capacity(size_t capacity) {
+    if(capacity <= UINT8_MAX) return STR_TYPE_8;
+    if(capacity <= UINT16_MAX) return STR_TYPE_16;
+    if((uint64_t)capacity <= UINT32_MAX) return STR_TYPE_32;
+    return STR_TYPE_64;
+}
+
+// Size of everything that comes before the data, allocator included
+static size_t prefix_size(uint8_t flags) {
+    size_t size = header_sizes[flags & STR_TYPE_MASK];
+    if(flags & STR_HAS_ALLOCATOR) size += sizeof(const ext_allocator*);
+    return size;
+}
+
+static void invalidate_hash(char* s) {
+    s[-1] = STR_FLAGS(s) & ~STR_HASH_VALID;
+}
+
+// Every function that changes the size of the string goes through here, so this is also where
+// we invalidate the cached hash
+static void ext_str_set_size(ext_string* str, size_t size) {
+    char* s = *str;
+    invalidate_hash(s);
+    switch(STR_TYPE(s)) {
+    case STR_TYPE_8:
+        STR_HDR(str_header8, s)->size = (uint8_t)size;
+        break;
+    case STR_TYPE_16:
+        STR_HDR(str_header16, s)->size = (uint16_t)size;
+        break;
+    case STR_TYPE_32:
+        STR_HDR(str_header32, s)->size = (uint32_t)size;
+        break;
+    default:
+        STR_HDR(str_header64, s)->size = size;
+        break;
+    }
+}
+
+static void set_capacity(char* s, size_t capacity) {
+    switch(STR_TYPE(s)) {
+    case STR_TYPE_8:
+        STR_HDR(str_header8, s)->capacity = (uint8_t)capacity;
+        break;
+    case STR_TYPE_16:
+        STR_HDR(str_header16, s)->capacity = (uint16_t)capacity;
+        break;
+    case STR_TYPE_32:
+        STR_HDR(str_header32, s)->capacity = (uint32_t)capacity;
+        break;
+    default:
+        STR_HDR(str_header64, s)->capacity = capacity;
+        break;
+    }
+}
+
+#ifdef EXTLIB_STATS
+static ext_str_statistics str_stats;
+#endif
+
+// Allocates an empty string with room for `capacity` characters, NUL terminator included
+static char* str_alloc(size_t capacity, const ext_allocator* allocator) {
+    uint8_t flags = type_for_capacity(capacity);
+    if(allocator) flags |= STR_HAS_ALLOCATOR;
+
+    size_t prefix = prefix_size(flags);
+    char* mem = ext_alloc(allocator, prefix + capacity);
+    ASSERT(mem, "Out of memory");
+
+    char* s = mem + prefix;
+    if(allocator) memcpy(mem, &allocator, sizeof(allocator));
+    s[-1] = flags;
+    ext_str_set_size(&s, 0);
+    set_capacity(s, capacity);
+    s[0] = '\0';
+    return s;
+}
+
+static void str_realloc(ext_string* str, size_t new_capacity) {
+    char* s = *str;
+    uint8_t flags = STR_FLAGS(s);
+    const ext_allocator* allocator = ext_str_allocator(s);
+    size_t prefix = prefix_size(flags);
+    size_t old_capacity = ext_str_capacity(s);
+    STAT_INC(str_stats.reallocs);
+    STAT_ADD(str_stats.realloc_bytes, new_capacity);
+
+    if((flags & STR_TYPE_MASK) == type_for_capacity(new_capacity)) {
+        char* mem = ext_realloc(allocator, s - prefix, prefix + old_capacity, prefix + new_capacity);
+        ASSERT(mem, "Out of memory");
+        s = mem + prefix;
+        set_capacity(s, new_capacity);
+    } else {
+        // The header changes size, so we cannot simply realloc
+        STAT_INC(str_stats.header_changes);
+        size_t size = ext_str_size(s);
+        char* new_s = str_alloc(new_capacity, allocator);
+        memcpy(new_s, s, size + 1);
+        ext_str_set_size(&new_s, size);
+        ext_free(allocator, s - prefix, prefix + old_capacity);
+        s = new_s;
+    }
+
+    *str = s;
+}
+
+// -----------------------------------------------------------------------------
+// NUMBER FORMATTING
+// -----------------------------------------------------------------------------
+
+// Enough for any formatted 64-bit integer or double, sign included
+#define NUM_BUF_SIZE 32
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static int count_digits(uint64_t n) {
+    int digits = 1;
+    for(;;) {
+        if(n < 10) return digits;
+        if(n < 100) return digits + 1;
+        if(n < 1000) return digits + 2;
+        if(n < 10000) return digits + 3;
+        n /= 10000;
+        digits += 4;
+    }
+}
+
+// Writes `n` in decimal at `buf`, two digits at a time. Returns the number of characters written.
+static int format_uint(char* buf, uint64_t n) {
+    int len = count_digits(n);
+    char* p = buf + len;
+    while(n >= 100) {
+        size_t pair = (n % 100) * 2;
+        n /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if(n >= 10) {
+        *--p = digit_pairs[n * 2 + 1];
+        *--p = digit_pairs[n * 2];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    return len;
+}
+
+static int format_int(char* buf, int64_t n) {
+    if(n < 0) {
+        *buf = '-';
+        return 1 + format_uint(buf + 1, -(uint64_t)n);
+    }
+    return format_uint(buf, n);
+}
+
+static int format_hex(char* buf, uint64_t n) {
+    static const char hex_digits[] = "0123456789abcdef";
+    int len = 1;
+    for(uint64_t m = n >> 4; m; m >>= 4) len++;
+    for(int i = len - 1; i >= 0; i--) {
+        buf[i] = hex_digits[n & 0xf];
+        n >>= 4;
+    }
+    return len;
+}
+
+// Shortest round-trip formatting of doubles, using Florian Loitsch's Grisu2 algorithm as
+// implemented by Milo Yip (https://github.com/miloyip/dtoa-benchmark). Grisu2 always produces
+// digits that read back to the same double, and in the vast majority of cases the shortest ones.
+
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp;
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFull
+#define DP_EXPONENT_MASK    0x7FF0000000000000ull
+#define DP_HIDDEN_BIT       0x0010000000000000ull
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS    (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT     (-DP_EXPONENT_BIAS)
+
+static diy_fp diy_fp_from_double(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int biased_e = (int)((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    if(biased_e != 0) {
+        return (diy_fp){significand + DP_HIDDEN_BIT, biased_e - DP_EXPONENT_BIAS};
+    } else {
+        return (diy_fp){significand, DP_MIN_EXPONENT + 1};
+    }
+}
+
+static diy_fp diy_fp_mul(diy_fp x, diy_fp y) {
+    const uint64_t M32 = 0xFFFFFFFF;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    tmp += 1U << 31;  // Round
+    return (diy_fp){ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+}
+
+static diy_fp diy_fp_normalize(diy_fp x) {
+    while(!(x.f & ((uint64_t)1 << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static void diy_fp_boundaries(diy_fp v, diy_fp* minus, diy_fp* plus) {
+    diy_fp pl = {(v.f << 1) + 1, v.e - 1};
+    while(!(pl.f & (DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+    pl.e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+
+    diy_fp mi = v.f == DP_HIDDEN_BIT ? (diy_fp){(v.f << 2) - 1, v.e - 2}
+                                     : (diy_fp){(v.f << 1) - 1, v.e - 1};
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *plus = pl;
+    *minus = mi;
+}
+
+// Normalized powers of ten 10^-348, 10^-340, ..., 10^340
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+    0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+    0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+    0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+    0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+    0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+    0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+    0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+    0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+    0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+    0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+    0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+    0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+    0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+    0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+    0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+    0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+    0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+    0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+    0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+    0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+    0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+    0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+    0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+    0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+    0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+    0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+    0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+    0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066,
+};
+
+static diy_fp cached_power(int e, int* k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;  // dk must be positive, so we can use ceil
+    int ik = (int)dk;
+    if(dk - ik > 0.0) ik++;
+    unsigned index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));  // Decimal exponent of the cached power
+    return (diy_fp){cached_powers_f[index], cached_powers_e[index]};
+}
+
+static const uint64_t pow10_table[] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+static void grisu_round(char* buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+                        uint64_t wp_w) {
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+          (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void digit_gen(diy_fp w, diy_fp mp, uint64_t delta, char* buf, int* len, int* k) {
+    const diy_fp one = {(uint64_t)1 << -mp.e, mp.e};
+    const uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits(p1);
+    *len = 0;
+
+    while(kappa > 0) {
+        uint32_t div = (uint32_t)pow10_table[kappa - 1];
+        uint32_t d = p1 / div;
+        p1 %= div;
+        if(d || *len) buf[(*len)++] = (char)('0' + d);
+        kappa--;
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if(tmp <= delta) {
+            *k += kappa;
+            grisu_round(buf, *len, delta, tmp, pow10_table[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    for(;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if(d || *len) buf[(*len)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if(p2 < delta) {
+            *k += kappa;
+            int index = -kappa;
+            grisu_round(buf, *len, delta, p2, one.f, wp_w * (index < 20 ? pow10_table[index] : 0));
+            return;
+        }
+    }
+}
+
+// Generates the shortest digits of the positive double `d`, such that d = digits * 10^k
+static void grisu2(double d, char* buf, int* len, int* k) {
+    diy_fp v = diy_fp_from_double(d);
+    diy_fp w_m, w_p;
+    diy_fp_boundaries(v, &w_m, &w_p);
+
+    diy_fp c_mk = cached_power(w_p.e, k);
+    diy_fp w = diy_fp_mul(diy_fp_normalize(v), c_mk);
+    diy_fp wp = diy_fp_mul(w_p, c_mk);
+    diy_fp wm = diy_fp_mul(w_m, c_mk);
+    wm.f++;
+    wp.f--;
+    digit_gen(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+static int format_exponent(char* buf, int k) {
+    int len = 0;
+    if(k < 0) {
+        buf[len++] = '-';
+        k = -k;
+    }
+    return len + format_uint(buf + len, k);
+}
+
+// Lays out the `len` digits at `buf` representing digits * 10^k, using the exponential notation
+// only for very big or very small numbers. Returns the final length.
+static int prettify(char* buf, int len, int k) {
+    const int kk = len + k;  // 10^(kk - 1) <= v < 10^kk
+
+    if(k >= 0 && kk <= 21) {
+        // 1234e7 -> 12340000000.0
+        for(int i = len; i < kk; i++) buf[i] = '0';
+        buf[kk] = '.';
+        buf[kk + 1] = '0';
+        return kk + 2;
+    } else if(kk > 0 && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memmove(&buf[kk + 1], &buf[kk], len - kk);
+        buf[kk] = '.';
+        return len + 1;
+    } else if(kk > -6 && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        const int offset = 2 - kk;
+        memmove(&buf[offset], &buf[0], len);
+        buf[0] = '0';
+        buf[1] = '.';
+        for(int i = 2; i < offset; i++) buf[i] = '0';
+        return len + offset;
+    } else if(len == 1) {
+        // 1e30
+        buf[1] = 'e';
+        return 2 + format_exponent(&buf[2], kk - 1);
+    } else {
+        // 1234e30 -> 1.234e33
+        memmove(&buf[2], &buf[1], len - 1);
+        buf[1] = '.';
+        buf[len + 1] = 'e';
+        return len + 2 + format_exponent(&buf[len + 2], kk - 1);
+    }
+}
+
+static int format_double(char* buf, double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bool negative = bits >> 63;
+
+    if((bits & DP_EXPONENT_MASK) == DP_EXPONENT_MASK) {
+        if(bits & DP_SIGNIFICAND_MASK) {
+            memcpy(buf, "nan", 3);
+            return 3;
+        }
+        memcpy(buf, negative ? "-inf" : "inf", 4 - !negative);
+        return 4 - !negative;
+    }
+
+    int len = 0;
+    if(negative) {
+        buf[len++] = '-';
+        d = -d;
+    }
+
+    if(d == 0) {
+        memcpy(buf + len, "0.0", 3);
+        return len + 3;
+    }
+
+    int digits, k;
+    grisu2(d, buf + len, &digits, &k);
+    return len + prettify(buf + len, digits, k);
+}
+
+// -----------------------------------------------------------------------------
+// STRING
+// -----------------------------------------------------------------------------
+
+static void ext_str_maybe_grow(ext_string* str, size_t amount) {
+    size_t size = ext_str_size(*str);
+    size_t capacity = ext_str_capacity(*str);
+    if(size + amount >= capacity) {
+        size_t new_capacity = capacity;
+        while(new_capacity <= size + amount) {
+            new_capacity += new_capacity > SLOW_GROWTH_TRESH ? new_capacity / 2 : new_capacity;
+        }
+
+        str_realloc(str, new_capacity);
+    }
+}
+
+ext_string ext_str_new_cap_with_allocator(size_t capacity, const ext_allocator* allocator) {
+    return str_alloc(capacity + 1, allocator);
+}
+
 ext_string ext_str_new_cap(size_t capacity) {
-    str_header_t* header = malloc(sizeof(*header) + capacity + 1);
-    header->size = 0;
-    header->capacity = capacity + 1;
-    return header->data;
+    return ext_str_new_cap_with_allocator(capacity, NULL);
+}
+
+ext_string ext_str_new_len_with_allocator(const void* data, size_t len,
+                                          const ext_allocator* allocator) {
+    ext_string str = ext_str_new_cap_with_allocator(len, allocator);
+    memcpy(str, data, len);
+    str[len] = '\0';
+    ext_str_set_size(&str, len);
+    return str;
 }
 
 ext_string ext_str_new_len(const void* data, size_t len) {
-    str_header_t* header = malloc(sizeof(*header) + len + 1);
-    ASSERT(header, "Out of memory");
-    memcpy(header->data, data, len);
-    header->data[len] = '\0';
-    header->capacity = len + 1;
-    header->size = len;
-    return header->data;
+    return ext_str_new_len_with_allocator(data, len, NULL);
 }
 
 ext_string ext_str_dup(const ext_string str) {
@@ -66,24 +938,24 @@ ext_string ext_str_new(const char* cstring) {
 }
 
 ext_string ext_str_vfmt(const char* fmt, va_list ap) {
-    ext_string str = ext_str_new_cap(strlen(fmt) * 2);
-    size_t capacity = ext_str_capacity(str);
+    // Format into a stack buffer first, so that short strings only need one vsnprintf call
+    char buf[256];
 
     va_list args;
     va_copy(args, ap);
-    size_t written = vsnprintf(str, capacity, fmt, args);
+    int written = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
+    ASSERT(written >= 0, "Encoding error");
 
-    if(written >= capacity) {
-        ext_str_maybe_grow(&str, written);
-        capacity = ext_str_capacity(str);
+    if((size_t)written < sizeof(buf)) {
+        return ext_str_new_len(buf, written);
+    }
 
-        va_copy(args, ap);
-        written = vsnprintf(str, capacity, fmt, args);
-        va_end(args);
+    ext_string str = ext_str_new_cap(written);
 
-        ASSERT(written < capacity, "Buffer still to small");
-    }
+    va_copy(args, ap);
+    vsnprintf(str, written + 1, fmt, args);
+    va_end(args);
 
     ext_str_set_size(&str, written);
     return str;
@@ -98,16 +970,25 @@ ext_string ext_str_fmt(const char* fmt, ...) {
 }
 
 void ext_str_free(ext_string str) {
-    if(str) free(ext_str_header(str));
+    if(str) {
+        size_t prefix = prefix_size(STR_FLAGS(str));
+        ext_free(ext_str_allocator(str), str - prefix, prefix + ext_str_capacity(str));
+    }
 }
 
 ext_string ext_str_join(const char* sep, char** strings, int count) {
     if(count == 0) return ext_str_new_len("", 0);
 
-    ext_string joined = ext_str_new_cap(strlen(strings[0]) * 2);
+    size_t sep_len = strlen(sep);
+    size_t total = sep_len * (count - 1);
+    for(int i = 0; i < count; i++) {
+        total += strlen(strings[i]);
+    }
+
+    ext_string joined = ext_str_new_cap(total);
     for(int i = 0; i < count; i++) {
         ext_str_append(&joined, strings[i]);
-        if(i != count - 1) ext_str_append(&joined, sep);
+        if(i != count - 1) ext_str_append_len(&joined, sep, sep_len);
     }
 
     return joined;
@@ -116,10 +997,16 @@ ext_string ext_str_join(const char* sep, char** strings, int count) {
 ext_string ext_str_join_str(const char* sep, ext_string* strings, int count) {
     if(count == 0) return ext_str_new_len("", 0);
 
-    ext_string joined = ext_str_new_cap(ext_str_size(strings[0]) * 2);
+    size_t sep_len = strlen(sep);
+    size_t total = sep_len * (count - 1);
+    for(int i = 0; i < count; i++) {
+        total += ext_str_size(strings[i]);
+    }
+
+    ext_string joined = ext_str_new_cap(total);
     for(int i = 0; i < count; i++) {
         ext_str_append_str(&joined, strings[i]);
-        if(i != count - 1) ext_str_append(&joined, sep);
+        if(i != count - 1) ext_str_append_len(&joined, sep, sep_len);
     }
 
     return joined;
@@ -180,19 +1067,46 @@ void ext_str_append_fmt(ext_string* str, const char* fmt, ...) {
     va_end(args);
 }
 
+void ext_str_append_int(ext_string* str, int64_t n) {
+    ext_str_maybe_grow(str, NUM_BUF_SIZE);
+    size_t size = ext_str_size(*str);
+    size += format_int(*str + size, n);
+    (*str)[size] = '\0';
+    ext_str_set_size(str, size);
+}
+
+void ext_str_append_uint(ext_string* str, uint64_t n) {
+    ext_str_maybe_grow(str, NUM_BUF_SIZE);
+    size_t size = ext_str_size(*str);
+    size += format_uint(*str + size, n);
+    (*str)[size] = '\0';
+    ext_str_set_size(str, size);
+}
+
+void ext_str_append_hex(ext_string* str, uint64_t n) {
+    ext_str_maybe_grow(str, NUM_BUF_SIZE);
+    size_t size = ext_str_size(*str);
+    size += format_hex(*str + size, n);
+    (*str)[size] = '\0';
+    ext_str_set_size(str, size);
+}
+
+void ext_str_append_double(ext_string* str, double d) {
+    ext_str_maybe_grow(str, NUM_BUF_SIZE);
+    size_t size = ext_str_size(*str);
+    size += format_double(*str + size, d);
+    (*str)[size] = '\0';
+    ext_str_set_size(str, size);
+}
+
 size_t ext_str_find_len(ext_string str, size_t start_pos, const void* needle, size_t len) {
     size_t str_size = ext_str_size(str);
-    if(str_size < len) {
+    if(str_size < len || start_pos > str_size - len) {
         return ext_str_npos;
     }
 
-    for(size_t i = start_pos; i <= str_size - len; i++) {
-        if(memcmp(str + i, needle, len) == 0) {
-            return i;
-        }
-    }
-
-    return ext_str_npos;
+    const char* found = search_forward(str + start_pos, str_size - start_pos, needle, len);
+    return found ? (size_t)(found - str) : ext_str_npos;
 }
 
 size_t ext_str_find_str(const ext_string str, size_t start_pos, const ext_string needle) {
@@ -217,13 +1131,10 @@ size_t ext_str_rfind_len(const ext_string str, size_t start_pos, const void* nee
         start_pos = len - 1;
     }
 
-    for(size_t i = str_size - start_pos - 1; i != ext_str_npos; i--) {
-        if(memcmp(str + i, needle, len) == 0) {
-            return i;
-        }
-    }
-
-    return ext_str_npos;
+    // Search for the last occurrence starting at or before `last`
+    size_t last = str_size - start_pos - 1;
+    const char* found = search_backward(str, last + len, needle, len);
+    return found ? (size_t)(found - str) : ext_str_npos;
 }
 
 size_t ext_str_rfind_str(const ext_string str, size_t start_pos, const ext_string needle) {
@@ -235,47 +1146,57 @@ size_t ext_str_rfind(const ext_string str, size_t start_pos, const char* needle)
 }
 
 size_t ext_str_find_char(const ext_string str, size_t start_pos, int c) {
-    for(size_t i = start_pos; i < ext_str_size(str); i++) {
-        if(str[i] == c) return i;
-    }
-    return ext_str_npos;
+    size_t size = ext_str_size(str);
+    if(start_pos >= size || c < CHAR_MIN || c > CHAR_MAX) return ext_str_npos;
+
+    const char* found = memchr(str + start_pos, c, size - start_pos);
+    return found ? (size_t)(found - str) : ext_str_npos;
 }
 
 size_t ext_str_rfind_char(const ext_string str, size_t start_pos, int c) {
-    if(start_pos >= ext_str_size(str)) return ext_str_npos;
+    size_t size = ext_str_size(str);
+    if(start_pos >= size || c < CHAR_MIN || c > CHAR_MAX) return ext_str_npos;
 
-    for(size_t i = ext_str_size(str) - start_pos - 1; i != ext_str_npos; i--) {
-        if(str[i] == c) return i;
-    }
-    return ext_str_npos;
+    const char* found = find_last_char(str, size - start_pos, (char)c);
+    return found ? (size_t)(found - str) : ext_str_npos;
 }
 
 void ext_str_to_lower(ext_string str) {
-    for(size_t i = 0; i < ext_str_size(str); i++) {
+    invalidate_hash(str);
+    size_t size = ext_str_size(str);
+    for(size_t i = 0; i < size; i++) {
         str[i] = tolower(str[i]);
     }
 }
 
 void ext_str_to_upper(ext_string str) {
-    for(size_t i = 0; i < ext_str_size(str); i++) {
+    invalidate_hash(str);
+    size_t size = ext_str_size(str);
+    for(size_t i = 0; i < size; i++) {
         str[i] = toupper(str[i]);
     }
 }
 
+void ext_str_to_lower_ascii(ext_string str) {
+    invalidate_hash(str);
+    ascii_flip_case(str, ext_str_size(str), 'A', 'Z');
+}
+
+void ext_str_to_upper_ascii(ext_string str) {
+    invalidate_hash(str);
+    ascii_flip_case(str, ext_str_size(str), 'a', 'z');
+}
+
 ext_vector(ext_string) ext_str_split(const ext_string str, char sep) {
     ext_vector(ext_string) tokens = NULL;
 
-    char* last = str;
-    for(size_t i = 0; i < ext_str_size(str); i++) {
-        if(str[i] == sep) {
-            ext_string tok = ext_str_new_len(last, str + i - last);
-            ext_vec_push_back(tokens, tok);
-            last = str + i + 1;
-        }
+    ext_strtok tokenizer = ext_strtok_new(ext_str_view(str), sep);
+    ext_strview tok;
+    while(ext_strtok_next(&tokenizer, &tok)) {
+        ext_string s = ext_strview_to_str(tok);
+        ext_vec_push_back(tokens, s);
     }
 
-    ext_string tok = ext_str_new_len(last, str + ext_str_size(str) - last);
-    ext_vec_push_back(tokens, tok);
     return tokens;
 }
 
@@ -291,24 +1212,14 @@ void ext_str_shrink_to_fit(ext_string* str) {
     size_t size = ext_str_size(*str);
 
     if(size + 1 < capacity) {
-        str_header_t* header = ext_str_header(*str);
-        header = realloc(header, sizeof(*header) + size + 1);
-        ASSERT(header, "Out of memory");
-        header->capacity = size + 1;
-
-        *str = header->data;
+        str_realloc(str, size + 1);
     }
 }
 
 void ext_str_reserve(ext_string* str, size_t amount) {
     size_t capacity = ext_str_capacity(*str);
     if(amount + 1 > capacity) {
-        str_header_t* header = ext_str_header(*str);
-        header = realloc(header, sizeof(*header) + amount + 1);
-        ASSERT(header, "Out of memory");
-        header->capacity = amount + 1;
-
-        *str = header->data;
+        str_realloc(str, amount + 1);
     }
 }
 
@@ -326,9 +1237,471 @@ int ext_str_compare(const ext_string s1, const ext_string s2) {
 }
 
 size_t ext_str_size(const ext_string str) {
-    return ext_str_header(str)->size;
+    switch(STR_TYPE(str)) {
+    case STR_TYPE_8:
+        return STR_HDR(str_header8, str)->size;
+    case STR_TYPE_16:
+        return STR_HDR(str_header16, str)->size;
+    case STR_TYPE_32:
+        return STR_HDR(str_header32, str)->size;
+    default:
+        return STR_HDR(str_header64, str)->size;
+    }
+}
+
+ext_str_statistics ext_str_stats(void) {
+    ext_str_statistics stats = {0};
+#ifdef EXTLIB_STATS
+    stats = str_stats;
+#endif
+    return stats;
+}
+
+void ext_str_reset_stats(void) {
+#ifdef EXTLIB_STATS
+    memset(&str_stats, 0, sizeof(str_stats));
+#endif
 }
 
 size_t ext_str_capacity(const ext_string str) {
-    return ext_str_header(str)->capacity;
+    switch(STR_TYPE(str)) {
+    case STR_TYPE_8:
+        return STR_HDR(str_header8, str)->capacity;
+    case STR_TYPE_16:
+        return STR_HDR(str_header16, str)->capacity;
+    case STR_TYPE_32:
+        return STR_HDR(str_header32, str)->capacity;
+    default:
+        return STR_HDR(str_header64, str)->capacity;
+    }
+}
+
+uint32_t ext_str_hash(const ext_string str) {
+    uint32_t hash;
+    char* hash_ptr = str - 1 - sizeof(hash);
+    if(STR_FLAGS(str) & STR_HASH_VALID) {
+        memcpy(&hash, hash_ptr, sizeof(hash));
+    } else {
+        hash = ext_map_hash_bytes_fast(str, ext_str_size(str));
+        memcpy(hash_ptr, &hash, sizeof(hash));
+        str[-1] = STR_FLAGS(str) | STR_HASH_VALID;
+    }
+    return hash;
+}
+
+void ext_str_invalidate_hash(ext_string str) {
+    invalidate_hash(str);
+}
+
+uint32_t ext_str_map_hash(const void* entry) {
+    return ext_str_hash(*(const ext_string*)entry);
+}
+
+bool ext_str_map_compare(const void* e1, const void* e2) {
+    const ext_string s1 = *(const ext_string*)e1;
+    const ext_string s2 = *(const ext_string*)e2;
+    size_t size = ext_str_size(s1);
+    if(size != ext_str_size(s2)) return false;
+    // When both hashes are cached, we can tell most different strings apart without memcmp
+    if((STR_FLAGS(s1) & STR_FLAGS(s2) & STR_HASH_VALID) && ext_str_hash(s1) != ext_str_hash(s2)) {
+        return false;
+    }
+    return memcmp(s1, s2, size) == 0;
+}
+
+const ext_allocator* ext_str_allocator(const ext_string str) {
+    uint8_t flags = STR_FLAGS(str);
+    if(!(flags & STR_HAS_ALLOCATOR)) return NULL;
+
+    const ext_allocator* allocator;
+    memcpy(&allocator, str - prefix_size(flags), sizeof(allocator));
+    return allocator;
+}
+
+// -----------------------------------------------------------------------------
+// STRING VIEWS
+// -----------------------------------------------------------------------------
+
+ext_strview ext_strview_new(const void* data, size_t size) {
+    return (ext_strview){data, size};
+}
+
+ext_strview ext_strview_from_cstr(const char* cstring) {
+    return (ext_strview){cstring, strlen(cstring)};
+}
+
+ext_strview ext_str_view(const ext_string str) {
+    return (ext_strview){str, ext_str_size(str)};
+}
+
+ext_strview ext_strview_substr(ext_strview view, size_t start, size_t end) {
+    ASSERT(start <= end, "start must be less than or equal to end");
+    ASSERT(end <= view.size, "Buffer overflow");
+    return (ext_strview){view.data + start, end - start};
+}
+
+ext_string ext_strview_to_str(ext_strview view) {
+    return ext_str_new_len(view.data, view.size);
+}
+
+size_t ext_strview_find(ext_strview view, size_t start_pos, ext_strview needle) {
+    if(view.size < needle.size || start_pos > view.size - needle.size) {
+        return ext_str_npos;
+    }
+
+    if(needle.size == 0) return start_pos;
+    const char* found = search_forward(view.data + start_pos, view.size - start_pos, needle.data,
+                                       needle.size);
+    return found ? (size_t)(found - view.data) : ext_str_npos;
+}
+
+size_t ext_strview_find_char(ext_strview view, size_t start_pos, int c) {
+    if(start_pos >= view.size || c < CHAR_MIN || c > CHAR_MAX) return ext_str_npos;
+
+    const char* found = memchr(view.data + start_pos, c, view.size - start_pos);
+    return found ? (size_t)(found - view.data) : ext_str_npos;
+}
+
+int ext_strview_compare(ext_strview v1, ext_strview v2) {
+    size_t min_len = v1.size < v2.size ? v1.size : v2.size;
+
+    int res = min_len ? memcmp(v1.data, v2.data, min_len) : 0;
+    if(res == 0) {
+        return v1.size > v2.size ? 1 : (v1.size < v2.size ? -1 : 0);
+    }
+
+    return res;
+}
+
+bool ext_strview_eq(ext_strview v1, ext_strview v2) {
+    return v1.size == v2.size && (v1.size == 0 || memcmp(v1.data, v2.data, v1.size) == 0);
+}
+
+uint32_t ext_strview_hash(ext_strview view) {
+    return ext_map_hash_bytes_fast(view.data, view.size);
+}
+
+ext_vector(ext_strview) ext_str_split_view(const ext_string str, char sep) {
+    ext_vector(ext_strview) tokens = NULL;
+
+    ext_strtok tokenizer = ext_strtok_new(ext_str_view(str), sep);
+    ext_strview tok;
+    while(ext_strtok_next(&tokenizer, &tok)) {
+        ext_vec_push_back(tokens, tok);
+    }
+
+    return tokens;
+}
+
+ext_strtok ext_strtok_new(ext_strview view, char sep) {
+    return (ext_strtok){view, 0, sep, false};
+}
+
+bool ext_strtok_next(ext_strtok* tokenizer, ext_strview* tok) {
+    if(tokenizer->done) return false;
+
+    ext_strview view = tokenizer->view;
+    size_t start = tokenizer->pos;
+    size_t end = ext_strview_find_char(view, start, tokenizer->sep);
+
+    if(end == ext_str_npos) {
+        // Last token, that extends until the end of the view
+        end = view.size;
+        tokenizer->done = true;
+    }
+
+    *tok = (ext_strview){view.data + start, end - start};
+    tokenizer->pos = end + 1;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// STRING BUILDER
+// -----------------------------------------------------------------------------
+
+struct ext_strbuilder_chunk {
+    struct ext_strbuilder_chunk* next;
+    size_t size, capacity;
+    char data[];
+};
+
+// Returns a chunk with at least `amount` bytes available, allocating a new one if needed
+static ext_strbuilder_chunk* builder_reserve(ext_strbuilder* sb, size_t amount) {
+    ext_strbuilder_chunk* tail = sb->tail;
+    if(tail && tail->capacity - tail->size >= amount) {
+        return tail;
+    }
+
+    // Chunks double in size up to a limit, so that the number of chunks stays logarithmic for
+    // small builders without wasting too much memory for big ones
+    size_t capacity = tail ? tail->capacity * 2 : BUILDER_CHUNK_MIN;
+    if(capacity > BUILDER_CHUNK_MAX) capacity = BUILDER_CHUNK_MAX;
+    if(capacity < amount) capacity = amount;
+
+    ext_strbuilder_chunk* chunk = EXT_MALLOC(sizeof(*chunk) + capacity);
+    ASSERT(chunk, "Out of memory");
+    chunk->next = NULL;
+    chunk->size = 0;
+    chunk->capacity = capacity;
+
+    if(tail) {
+        tail->next = chunk;
+    } else {
+        sb->head = chunk;
+    }
+    sb->tail = chunk;
+
+    return chunk;
+}
+
+void ext_strbuilder_free(ext_strbuilder* sb) {
+    ext_strbuilder_chunk* chunk = sb->head;
+    while(chunk) {
+        ext_strbuilder_chunk* next = chunk->next;
+        EXT_FREE(chunk);
+        chunk = next;
+    }
+    *sb = (ext_strbuilder){NULL, NULL, 0};
+}
+
+void ext_strbuilder_append_len(ext_strbuilder* sb, const void* data, size_t len) {
+    if(len == 0) return;
+
+    ext_strbuilder_chunk* tail = sb->tail;
+    if(tail) {
+        // Fill what remains of the current chunk first
+        size_t available = tail->capacity - tail->size;
+        size_t n = len < available ? len : available;
+        memcpy(tail->data + tail->size, data, n);
+        tail->size += n;
+        sb->size += n;
+        data = (const char*)data + n;
+        len -= n;
+        if(len == 0) return;
+    }
+
+    ext_strbuilder_chunk* chunk = builder_reserve(sb, len);
+    memcpy(chunk->data + chunk->size, data, len);
+    chunk->size += len;
+    sb->size += len;
+}
+
+void ext_strbuilder_append(ext_strbuilder* sb, const char* cstring) {
+    ext_strbuilder_append_len(sb, cstring, strlen(cstring));
+}
+
+void ext_strbuilder_append_str(ext_strbuilder* sb, const ext_string str) {
+    ext_strbuilder_append_len(sb, str, ext_str_size(str));
+}
+
+void ext_strbuilder_append_vfmt(ext_strbuilder* sb, const char* fmt, va_list ap) {
+    ext_strbuilder_chunk* tail = sb->tail;
+    size_t available = tail ? tail->capacity - tail->size : 0;
+
+    va_list args;
+    va_copy(args, ap);
+    int written = vsnprintf(tail ? tail->data + tail->size : NULL, available, fmt, args);
+    va_end(args);
+    ASSERT(written >= 0, "Encoding error");
+
+    // vsnprintf always writes a NUL terminator, so we need room for it too
+    if((size_t)written >= available) {
+        tail = builder_reserve(sb, written + 1);
+
+        va_copy(args, ap);
+        written = vsnprintf(tail->data + tail->size, written + 1, fmt, args);
+        va_end(args);
+    }
+
+    tail->size += written;
+    sb->size += written;
+}
+
+void ext_strbuilder_append_fmt(ext_strbuilder* sb, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    ext_strbuilder_append_vfmt(sb, fmt, args);
+    va_end(args);
+}
+
+size_t ext_strbuilder_size(const ext_strbuilder* sb) {
+    return sb->size;
+}
+
+ext_string ext_strbuilder_to_str(const ext_strbuilder* sb) {
+    ext_string str = ext_str_new_cap(sb->size);
+    size_t size = 0;
+    for(const ext_strbuilder_chunk* chunk = sb->head; chunk; chunk = chunk->next) {
+        memcpy(str + size, chunk->data, chunk->size);
+        size += chunk->size;
+    }
+    str[size] = '\0';
+    ext_str_set_size(&str, size);
+    return str;
+}
+
+// -----------------------------------------------------------------------------
+// FILES
+// -----------------------------------------------------------------------------
+
+// Reads the whole file in memory, used when mapping is not possible
+static bool read_file(const char* path, ext_file_view* file) {
+    FILE* f = fopen(path, "rb");
+    if(!f) return false;
+
+    ext_string contents = ext_str_new_cap(READ_BUF_SIZE);
+    for(;;) {
+        ext_str_maybe_grow(&contents, READ_BUF_SIZE);
+        size_t size = ext_str_size(contents);
+        size_t read = fread(contents + size, 1, READ_BUF_SIZE, f);
+        contents[size + read] = '\0';
+        ext_str_set_size(&contents, size + read);
+        if(read < READ_BUF_SIZE) break;
+    }
+
+    bool error = ferror(f);
+    fclose(f);
+    if(error) {
+        ext_str_free(contents);
+        return false;
+    }
+
+    file->view = ext_str_view(contents);
+    file->mapped = false;
+    return true;
+}
+
+#if defined(STR_MMAP_POSIX)
+
+static bool map_file(const char* path, ext_file_view* file) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return false;
+
+    file->view = (ext_strview){data, st.st_size};
+    file->mapped = true;
+    return true;
+}
+
+static void unmap_file(ext_file_view* file) {
+    munmap((void*)file->view.data, file->view.size);
+}
+
+#elif defined(STR_MMAP_WIN32)
+
+static bool map_file(const char* path, ext_file_view* file) {
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if(handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if(!mapping) return false;
+
+    // The view keeps the mapping alive, so the handle can be closed right away
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(!data) return false;
+
+    file->view = (ext_strview){data, (size_t)size.QuadPart};
+    file->mapped = true;
+    return true;
+}
+
+static void unmap_file(ext_file_view* file) {
+    UnmapViewOfFile(file->view.data);
+}
+
+#else
+
+static bool map_file(const char* path, ext_file_view* file) {
+    UNUSED(path);
+    UNUSED(file);
+    return false;
+}
+
+static void unmap_file(ext_file_view* file) {
+    UNUSED(file);
+}
+
+#endif
+
+bool ext_file_view_open(const char* path, ext_file_view* file) {
+    return map_file(path, file) || read_file(path, file);
+}
+
+void ext_file_view_close(ext_file_view* file) {
+    if(file->mapped) {
+        unmap_file(file);
+    } else {
+        ext_str_free((ext_string)file->view.data);
+    }
+    *file = (ext_file_view){{NULL, 0}, false};
+}
+
+void ext_linereader_init(ext_linereader* reader, FILE* file, char delim) {
+    reader->file = file;
+    reader->delim = delim;
+    reader->eof = false;
+    reader->line = ext_str_new_cap(128);
+    reader->buf = EXT_MALLOC(READ_BUF_SIZE);
+    ASSERT(reader->buf, "Out of memory");
+    reader->buf_pos = 0;
+    reader->buf_len = 0;
+}
+
+void ext_linereader_free(ext_linereader* reader) {
+    ext_str_free(reader->line);
+    EXT_FREE(reader->buf);
+    reader->line = NULL;
+    reader->buf = NULL;
+}
+
+ext_string ext_linereader_next(ext_linereader* reader) {
+    ext_string* line = &reader->line;
+    ext_str_set_size(line, 0);
+    (*line)[0] = '\0';
+
+    bool found = false;
+    for(;;) {
+        if(reader->buf_pos == reader->buf_len) {
+            if(reader->eof) break;
+            reader->buf_len = fread(reader->buf, 1, READ_BUF_SIZE, reader->file);
+            reader->buf_pos = 0;
+            if(reader->buf_len < READ_BUF_SIZE) reader->eof = true;
+            if(reader->buf_len == 0) break;
+        }
+
+        const char* start = reader->buf + reader->buf_pos;
+        size_t available = reader->buf_len - reader->buf_pos;
+        const char* end = memchr(start, reader->delim, available);
+
+        if(end) {
+            ext_str_append_len(line, start, end - start);
+            reader->buf_pos += end - start + 1;
+            found = true;
+            break;
+        }
+
+        ext_str_append_len(line, start, available);
+        reader->buf_pos = reader->buf_len;
+        found = true;
+    }
+
+    return found ? *line : NULL;
 }
@@ -0,0 +1,201 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE  // For mremap, must be defined before including any system header
+#endif
+
+#include "extlib/vm.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib/assert.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #if defined(__linux__)
+        #define VM_MREMAP
+    #endif
+#endif
+
+// Minimum amount of address space reserved for a mapping, when not using mremap
+#define MIN_RESERVE (sizeof(void*) >= 8 ? (size_t)1 << 30 : (size_t)1 << 24)
+
+static size_t page_size(void) {
+    static size_t size;
+    if(!size) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size = info.dwPageSize;
+#else
+        size = sysconf(_SC_PAGESIZE);
+#endif
+    }
+    return size;
+}
+
+static size_t round_to_pages(size_t size) {
+    size_t page = page_size();
+    return (size + page - 1) & ~(page - 1);
+}
+
+// -----------------------------------------------------------------------------
+// MAPPINGS
+// -----------------------------------------------------------------------------
+
+#ifdef VM_MREMAP
+
+// Mappings are exactly as big as the allocation, as they can be grown in place or moved by remapping
+// their pages. The kernel only backs the pages with memory when they are first touched.
+
+static void* map_alloc(size_t size) {
+    void* mem = mmap(NULL, round_to_pages(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+static void* map_realloc(void* ptr, size_t old_size, size_t new_size) {
+    void* mem = mremap(ptr, round_to_pages(old_size), round_to_pages(new_size), MREMAP_MAYMOVE);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+static void map_free(void* ptr, size_t size) {
+    munmap(ptr, round_to_pages(size));
+}
+
+#else
+
+// A mapping reserves address space for the next power of two of its size (but at least
+// MIN_RESERVE), and only commits the pages it uses. As the reserved size is a function of the
+// allocation size, there's no need to store it anywhere.
+static size_t reserve_size(size_t size) {
+    size = round_to_pages(size);
+    if(size <= MIN_RESERVE) return MIN_RESERVE;
+    if(size > SIZE_MAX / 2) return size;
+    size_t reserve = MIN_RESERVE;
+    while(reserve < size) reserve *= 2;
+    return reserve;
+}
+
+    #ifdef _WIN32
+
+static void* os_reserve(size_t size) {
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+static bool os_commit(void* ptr, size_t size) {
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+static void os_decommit(void* ptr, size_t size) {
+    VirtualFree(ptr, size, MEM_DECOMMIT);
+}
+
+static void os_release(void* ptr, size_t size) {
+    UNUSED(size);
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+    #else
+
+static void* os_reserve(size_t size) {
+    void* mem = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+}
+
+static bool os_commit(void* ptr, size_t size) {
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void os_decommit(void* ptr, size_t size) {
+    // Mapping fresh inaccessible pages over the old ones gives their memory back to the OS
+    mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+}
+
+static void os_release(void* ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+    #endif
+
+static void* map_alloc(size_t size) {
+    size_t reserve = reserve_size(size);
+    void* mem = os_reserve(reserve);
+    if(!mem) return NULL;
+    if(!os_commit(mem, round_to_pages(size))) {
+        os_release(mem, reserve);
+        return NULL;
+    }
+    return mem;
+}
+
+static void map_free(void* ptr, size_t size) {
+    os_release(ptr, reserve_size(size));
+}
+
+static void* map_realloc(void* ptr, size_t old_size, size_t new_size) {
+    if(reserve_size(old_size) != reserve_size(new_size)) {
+        void* mem = map_alloc(new_size);
+        if(!mem) return NULL;
+        memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+        map_free(ptr, old_size);
+        return mem;
+    }
+
+    size_t old_committed = round_to_pages(old_size);
+    size_t new_committed = round_to_pages(new_size);
+    if(new_committed > old_committed) {
+        if(!os_commit((char*)ptr + old_committed, new_committed - old_committed)) return NULL;
+    } else if(new_committed < old_committed) {
+        os_decommit((char*)ptr + new_committed, old_committed - new_committed);
+    }
+    return ptr;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// ALLOCATOR
+// -----------------------------------------------------------------------------
+
+// Whether an allocation is mapped only depends on its size, so it can always be determined from
+// the sizes passed to realloc and free
+
+static void* vm_alloc(void* ctx, size_t size) {
+    UNUSED(ctx);
+    return size < EXT_VM_THRESHOLD ? EXT_MALLOC(size) : map_alloc(size);
+}
+
+static void vm_free(void* ctx, void* ptr, size_t size) {
+    UNUSED(ctx);
+    if(size < EXT_VM_THRESHOLD) {
+        EXT_FREE(ptr);
+    } else {
+        map_free(ptr, size);
+    }
+}
+
+static void* vm_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+    if(!ptr) return vm_alloc(ctx, new_size);
+
+    bool old_mapped = old_size >= EXT_VM_THRESHOLD;
+    bool new_mapped = new_size >= EXT_VM_THRESHOLD;
+    if(!old_mapped && !new_mapped) return EXT_REALLOC(ptr, new_size);
+    if(old_mapped && new_mapped) return map_realloc(ptr, old_size, new_size);
+
+    // The allocation crosses the threshold, move it
+    void* mem = vm_alloc(ctx, new_size);
+    if(!mem) return NULL;
+    memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+    vm_free(ctx, ptr, old_size);
+    return mem;
+}
+
+static const ext_allocator vm_allocator = {vm_alloc, vm_realloc, vm_free, NULL};
+
+const ext_allocator* ext_vm_allocator(void) {
+    return &vm_allocator;
+}
@@ -0,0 +1,85 @@
+// Tests for ext_matcher. The process exits with a non-zero status at the first failed check.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "extlib/matcher.h"
+#include "extlib/string.h"
+#include "extlib/vector.h"
+
+// Unlike ASSERT, checks are never compiled out
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if(!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                      \
+        }                                                                            \
+    } while(0)
+
+static char all_bytes[256];
+
+// One single-byte pattern for every byte value, so that no byte class is left for unused bytes
+static void test_every_byte_single(void) {
+    ext_strview patterns[256];
+    for(int i = 0; i < 256; i++) patterns[i] = ext_strview_new(&all_bytes[i], 1);
+    ext_matcher* m = ext_matcher_new(patterns, 256);
+
+    ext_vector(ext_match) matches = ext_matcher_find_all(m, ext_strview_new(all_bytes, 256));
+    CHECK(ext_vec_size(matches) == 256);
+    for(size_t i = 0; i < 256; i++) {
+        CHECK(matches[i].pattern == i);
+        CHECK(matches[i].offset == i);
+    }
+    ext_vec_free(matches);
+
+    ext_match match;
+    CHECK(ext_matcher_find_any(m, ext_strview_new(&all_bytes[255], 1), &match));
+    CHECK(match.pattern == 255 && match.offset == 0);
+    ext_matcher_free(m);
+}
+
+// Two-byte binary patterns {i, 255 - i} covering every byte value, so that the patterns share
+// bytes and nodes have transitions on all classes
+static void test_every_byte_pairs(void) {
+    char data[256][2];
+    ext_strview patterns[256];
+    for(int i = 0; i < 256; i++) {
+        data[i][0] = (char)i;
+        data[i][1] = (char)(255 - i);
+        patterns[i] = ext_strview_new(data[i], 2);
+    }
+    ext_matcher* m = ext_matcher_new(patterns, 256);
+
+    // Every pair of adjacent bytes in the text is one of the patterns
+    char text[] = {0, (char)255, 0, 1, (char)254, 1};
+    ext_vector(ext_match) matches = ext_matcher_find_all(m, ext_strview_new(text, sizeof(text)));
+    CHECK(ext_vec_size(matches) == 4);
+    CHECK(matches[0].pattern == 0 && matches[0].offset == 0);
+    CHECK(matches[1].pattern == 255 && matches[1].offset == 1);
+    CHECK(matches[2].pattern == 1 && matches[2].offset == 3);
+    CHECK(matches[3].pattern == 254 && matches[3].offset == 4);
+    ext_vec_free(matches);
+
+    CHECK(!ext_matcher_find_any(m, ext_strview_new(all_bytes + 1, 2), NULL));
+    ext_matcher_free(m);
+}
+
+// Bytes that appear in no pattern must never match
+static void test_unused_bytes(void) {
+    ext_strview patterns[] = {ext_strview_from_cstr("he"), ext_strview_from_cstr("she")};
+    ext_matcher* m = ext_matcher_new(patterns, 2);
+
+    CHECK(!ext_matcher_find_any(m, ext_strview_new(all_bytes, 256), NULL));
+    ext_match match;
+    CHECK(ext_matcher_find_any(m, ext_strview_from_cstr("ushers"), &match));
+    CHECK(match.pattern == 1 && match.offset == 1);
+    ext_matcher_free(m);
+}
+
+int main(void) {
+    for(int i = 0; i < 256; i++) all_bytes[i] = (char)i;
+    test_every_byte_single();
+    test_every_byte_pairs();
+    test_unused_bytes();
+    return EXIT_SUCCESS;
+}
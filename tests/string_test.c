@@ -0,0 +1,82 @@
+// Tests for the substring search of ext_string. The process exits with a non-zero status at the
+// first failed check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlib/string.h"
+
+// Unlike ASSERT, checks are never compiled out
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if(!(cond)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(EXIT_FAILURE);                                                      \
+        }                                                                            \
+    } while(0)
+
+static size_t naive_find(const char* hay, size_t n, const char* needle, size_t m) {
+    for(size_t i = 0; i + m <= n; i++) {
+        if(memcmp(hay + i, needle, m) == 0) return i;
+    }
+    return ext_str_npos;
+}
+
+static size_t naive_rfind(const char* hay, size_t n, const char* needle, size_t m) {
+    for(size_t i = n >= m ? n - m + 1 : 0; i-- > 0;) {
+        if(memcmp(hay + i, needle, m) == 0) return i;
+    }
+    return ext_str_npos;
+}
+
+static void check_search(const char* hay, size_t n, const char* needle, size_t m) {
+    ext_string str = ext_str_new_len(hay, n);
+    CHECK(ext_str_find_len(str, 0, needle, m) == naive_find(hay, n, needle, m));
+    CHECK(ext_str_rfind_len(str, 0, needle, m) == naive_rfind(hay, n, needle, m));
+    ext_str_free(str);
+}
+
+static unsigned long long rng_state = 1;
+
+static unsigned rng_next(void) {
+    rng_state = rng_state * 6364136223846793005ull + 1442695040888963407ull;
+    return rng_state >> 33;
+}
+
+// Random haystacks and needles over small alphabets, so that candidates are frequent
+static void test_random(void) {
+    static char hay[20000], needle[200];
+    for(int iter = 0; iter < 5000; iter++) {
+        int alphabet = 1 + rng_next() % 4;
+        size_t n = rng_next() % sizeof(hay);
+        size_t m = 2 + rng_next() % (sizeof(needle) - 2);
+        for(size_t i = 0; i < n; i++) hay[i] = 'a' + rng_next() % alphabet;
+        for(size_t i = 0; i < m; i++) needle[i] = 'a' + rng_next() % alphabet;
+        if(n >= m && rng_next() % 2) memcpy(hay + rng_next() % (n - m + 1), needle, m);
+        check_search(hay, n, needle, m);
+    }
+}
+
+// Needles whose first and last bytes match everywhere, so that the filter gives up and the search
+// continues with Two-Way
+static void test_filter_exhausted(void) {
+    static char hay[100000], needle[101];
+    memset(hay, 'a', sizeof(hay));
+    memset(needle, 'a', sizeof(needle));
+    needle[50] = 'b';
+    check_search(hay, sizeof(hay), needle, sizeof(needle));
+
+    size_t positions[] = {0, 10, 5000, sizeof(hay) / 2, sizeof(hay) - sizeof(needle)};
+    for(size_t i = 0; i < sizeof(positions) / sizeof(*positions); i++) {
+        memset(hay, 'a', sizeof(hay));
+        memcpy(hay + positions[i], needle, sizeof(needle));
+        check_search(hay, sizeof(hay), needle, sizeof(needle));
+    }
+}
+
+int main(void) {
+    test_random();
+    test_filter_exhausted();
+    return EXIT_SUCCESS;
+}